@@ -0,0 +1,33 @@
+#version 430 core
+
+// fills a storage buffer with values[i] = i * scale + offset (see bench/ComputeBenchmark.cpp),
+// the first thread also writes the work groups of a dispatch over the buffer, so it can be
+// dispatched indirectly with the parameters written by the GPU
+
+layout(local_size_x = 64) in;
+
+layout(std430, binding = 0) buffer Values
+{
+    float values[];
+};
+
+layout(std430, binding = 1) buffer Dispatch
+{
+    uvec3 groups;
+};
+
+uniform int count;
+uniform float scale = 1.0;
+uniform float offset = 0.0;
+
+void main()
+{
+    uint i = gl_GlobalInvocationID.x;
+    if (i == 0u)
+        groups = uvec3((uint(count) + gl_WorkGroupSize.x - 1u) / gl_WorkGroupSize.x, 1u, 1u);
+
+    if (i >= uint(count))
+        return;
+
+    values[i] = float(i) * scale + offset;
+}
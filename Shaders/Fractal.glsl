@@ -0,0 +1,47 @@
+// Codigo comun de los fractales, el shader que lo incluye define antes:
+//  - MAXITER: numero maximo de iteraciones.
+//  - FRACTAL_CENTER: punto complejo en el que se hace zoom.
+//  - FRACTAL_C: constante del conjunto de julia.
+//  - int julia(vec2 z, vec2 c): numero de iteraciones del punto z.
+
+#include "FrameBlock.glsl"
+#include "LodDither.glsl"
+
+out vec4 fragColor;
+
+//Transformamos las coordenadas de la pantalla a puntos complejos en el espacio definido.
+vec2 pixelToComplex(vec2 resolucion, vec2 pixelPosition, float zoom){
+
+    vec2 vectorComplejo = (2.*pixelPosition.xy - resolucion.xy) / resolucion.x;
+
+    //Movemos para hacer zoom justo a un espiral.
+    return vectorComplejo/(zoom*zoom) + FRACTAL_CENTER;
+}
+
+//Funcion principal que correra el shader.
+void mainImage(out vec4 fragColor,in vec2 fragCoord ){
+
+    //obtenemos la posicion del punto en complejo
+    vec2 z = pixelToComplex(iResolution.xy, fragCoord.xy, iTime);
+
+    // Ejecutamos la funcion de julia, y guardamos el numero de la iteracion
+    int iter = julia(z, FRACTAL_C);
+
+    //Solo hay blancos o negros
+    fragColor = vec4(vec3(float(iter)/float(MAXITER)),1.0);
+}
+
+void main(){
+
+    //Descartamos los pixeles del nivel de detalle que no se dibujan en una transicion
+    lodDither();
+
+    //Variable para almacenar el color de salida
+    vec4 color;
+
+    //Llamamos a la funcion principal del shader
+    mainImage(color,gl_FragCoord.xy);
+
+    //Asignamos el color a la salida del shader
+    fragColor = color;
+}
@@ -0,0 +1,12 @@
+// uniforms of the frame, shared by all the shaders (see FrameUniforms.h)
+layout(std140) uniform FrameBlock
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec3 iResolution;
+    float iTime;
+    float iTimeDelta;
+    int iFrame;
+};
@@ -0,0 +1,15 @@
+// dithered transition between two levels of detail (see LodSelector::setDither), the Scene
+// sets lodFade to the fraction of pixels drawn by the level (negative for the level that
+// fades out), the fragment shaders call lodDither() at the beginning of their main
+
+uniform float lodFade = 1.0;
+
+void lodDither()
+{
+    // ordered dither (4x4 Bayer matrix), the two levels of a transition keep complementary pixels
+    const float bayer[16] = float[16](0.0, 8.0, 2.0, 10.0, 12.0, 4.0, 14.0, 6.0, 3.0, 11.0, 1.0, 9.0, 15.0, 7.0, 13.0, 5.0);
+    ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+    float threshold = (bayer[pixel.y * 4 + pixel.x] + 0.5) / 16.0;
+    if (lodFade >= 0.0 ? threshold > lodFade : threshold <= -lodFade)
+        discard;
+}
@@ -0,0 +1,11 @@
+// decoding of the octahedral normals of the quantized vertex formats (see VertexFormat), the
+// shaders declare the normal as vec2 (layout(location = 2) in vec2 aNormal;) and decode it
+// with octahedralDecode (the same mapping as VertexQuantizer::octahedralDecode)
+
+vec3 octahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
@@ -5,8 +5,11 @@ out vec4 FragColor;
 // INPUT
 in vec3 ourColor;
 
+#include "LodDither.glsl"
+
 // SHADER
 void main()
 {
+	lodDither();
 	FragColor = vec4(ourColor, 1.0f);
 }
\ No newline at end of file
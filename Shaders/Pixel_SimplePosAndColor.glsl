@@ -3,7 +3,10 @@ out vec4 FragColor;
 
 in vec3 ourColor;
 
+#include "LodDither.glsl"
+
 void main()
 {
+    lodDither();
     FragColor = vec4(ourColor, 1.0f);
 }
\ No newline at end of file
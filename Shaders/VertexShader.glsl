@@ -2,10 +2,9 @@
 
 // INPUT
 layout(location = 0) in vec3 aPos;
+layout(location = 4) in mat4 aInstanceModel;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "FrameBlock.glsl"
 
 // OUTPUT
 out vec3 ourColor;
@@ -14,5 +13,5 @@ out vec3 ourColor;
 void main()
 {
     ourColor = aPos;
-	gl_Position = projection * view * model * vec4(aPos, 1.0f);
+	gl_Position = viewProjection * aInstanceModel * vec4(aPos, 1.0f);
 }
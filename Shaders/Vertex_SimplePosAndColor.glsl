@@ -1,15 +1,14 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
+layout (location = 4) in mat4 aInstanceModel;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "FrameBlock.glsl"
 
 out vec3 ourColor;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    gl_Position = viewProjection * aInstanceModel * vec4(aPos, 1.0f);
     ourColor = aColor;
 }
\ No newline at end of file
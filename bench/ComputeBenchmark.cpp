@@ -0,0 +1,141 @@
+/**
+ * @file ComputeBenchmark.cpp
+ * @brief Benchmark and check of the compute shaders of the engine.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * Fill a storage buffer with Shaders/ComputeFill.glsl, with direct and indirect dispatches,
+ * read it back after the barriers and check the values. The time of the dispatches is
+ * measured waiting for the GPU (glFinish), so it includes the synchronization.
+ *
+ * Usage: ComputeBenchmark [iterations] [elements]
+ *
+ * It needs OpenGL 4.3, it can run without a GPU with Mesa llvmpipe (for example
+ * LIBGL_ALWAYS_SOFTWARE=1 xvfb-run ./ComputeBenchmark). The exit code is 1 if the values are
+ * wrong or the context can not run compute shaders.
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <ComputeShader.h>
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * @brief Check the values written by the shader.
+ *
+ * @param values Values read from the buffer.
+ * @param scale Scale given to the shader.
+ * @param offset Offset given to the shader.
+ * @return size_t Number of wrong values.
+ */
+size_t countErrors(const std::vector<float> &values, float scale, float offset)
+{
+    size_t errors = 0;
+    for (size_t i = 0; i < values.size(); i++)
+    {
+        if (std::fabs(values[i] - ((float)i * scale + offset)) > 1e-3f * std::fabs((float)i * scale + offset) + 1e-3f)
+            errors++;
+    }
+    return errors;
+}
+
+/**
+ * @brief Run a dispatch several times and print its time.
+ *
+ * @param name Name of the dispatch.
+ * @param iterations Times the dispatch is repeated.
+ * @param elements Number of values written by each dispatch.
+ * @param dispatch Function that does the dispatch.
+ */
+template <typename Dispatch>
+void runDispatch(const char *name, int iterations, size_t elements, Dispatch dispatch)
+{
+    glFinish();
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        dispatch();
+    glFinish();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double gigabytes = (double)elements * sizeof(float) * iterations / (1024.0 * 1024.0 * 1024.0);
+    std::printf("  %-22s %10.3f ms/dispatch %10.2f GB/s\n", name, seconds * 1000.0 / iterations, gigabytes / seconds);
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 100;
+    size_t elements = argc > 2 ? (size_t)std::atol(argv[2]) : 1 << 20;
+
+    // hidden window, only the context is used
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(64, 64, "ComputeBenchmark", nullptr, nullptr);
+    if (window == nullptr)
+    {
+        std::printf("OpenGL 4.3 context could not be created\n");
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(window);
+    gladLoadGLLoader((GLADloadproc)glfwGetProcAddress);
+    std::printf("%s | %s\n", glGetString(GL_VERSION), glGetString(GL_RENDERER));
+
+    int result = 0;
+    if (!ComputeShader::isSupported())
+    {
+        std::printf("compute shaders are not supported\n");
+        result = 1;
+    }
+    else
+    {
+        // the program is built every time, not taken from the binary cache
+        ProgramCache::shared().setEnabled(false);
+        ComputeShader fill("./Shaders/ComputeFill.glsl");
+        std::printf("work group size %u, %zu elements, %d iterations\n", fill.getWorkGroupSize().x, elements, iterations);
+
+        StorageBuffer values;
+        values.allocate(elements * sizeof(float));
+        values.bind(0);
+        DispatchIndirectCommand command = {0, 1, 1};
+        StorageBuffer parameters;
+        parameters.allocate(sizeof(command), &command);
+        parameters.bind(1);
+        fill.setInt("count", (int)elements);
+
+        // direct dispatch, one thread per value
+        fill.setFloat("scale", 2.0f);
+        fill.setFloat("offset", 1.0f);
+        runDispatch("dispatchThreads", iterations, elements, [&]() { fill.dispatchThreads((GLuint)elements); });
+        std::vector<float> read(elements);
+        values.read(0, elements * sizeof(float), read.data());
+        size_t errors = countErrors(read, 2.0f, 1.0f);
+        std::printf("  %-22s %zu wrong values\n", "", errors);
+
+        // indirect dispatch, with the work groups written by the previous dispatch
+        fill.setFloat("scale", 0.5f);
+        fill.setFloat("offset", -3.0f);
+        runDispatch("dispatchIndirect", iterations, elements, [&]() { fill.dispatchIndirect(parameters); });
+        values.read(0, elements * sizeof(float), read.data());
+        size_t indirectErrors = countErrors(read, 0.5f, -3.0f);
+        std::printf("  %-22s %zu wrong values\n", "", indirectErrors);
+
+        std::printf("%zu barriers, %s\n", MemoryBarriers::shared().getBarrierCount(), errors + indirectErrors == 0 ? "OK" : "FAILED");
+        result = errors + indirectErrors == 0 ? 0 : 1;
+
+        values.release();
+        parameters.release();
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return result;
+}
@@ -0,0 +1,233 @@
+/**
+ * @file LoaderBenchmark.cpp
+ * @brief Benchmark of the loaders of models of the engine.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * Measure the throughput (MB/s) of the different ways of loading a .obj file. The legacy
+ * loader (split + stof/stoi) is kept here as the baseline to compare against.
+ *
+ * Usage: LoaderBenchmark [iterations] [files...]
+ *
+ * To measure the scaling of the parallel parser use a big file, for example the Gastly model
+ * concatenated with itself until it reaches the GB size.
+ */
+
+#include <glad/glad.h>
+#include <Model.h>
+#include <Utils.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Loader used by the engine before the ObjParser, used as baseline.
+ *
+ * @param filename Name of the file.
+ * @return std::vector<float> Vertices of the triangles of the model.
+ */
+std::vector<float> legacyLoadObj(const std::string &filename)
+{
+    std::ifstream infile(filename);
+    std::string line = "";
+    std::vector<std::string> parsed_line;
+
+    std::vector<std::vector<float>> vertices;
+    std::vector<std::vector<int>> faces;
+
+    while (std::getline(infile, line))
+    {
+        parsed_line = split(line, ' ');
+        if (parsed_line.size() == 0)
+            continue;
+
+        if (parsed_line[0].compare("v") == 0)
+        {
+            std::vector<float> new_vertex;
+            new_vertex.push_back(std::stof(parsed_line[1]));
+            new_vertex.push_back(std::stof(parsed_line[2]));
+            new_vertex.push_back(std::stof(parsed_line[3]));
+            vertices.push_back(new_vertex);
+        }
+
+        if (parsed_line[0].compare("f") == 0)
+        {
+            std::vector<int> face;
+            for (size_t i = 1; i < parsed_line.size(); i++)
+                face.push_back(std::stoi(split(parsed_line[i], '/')[0]));
+            faces.push_back(face);
+        }
+    }
+
+    std::vector<float> vertices_triangles;
+    for (std::vector<int> face : faces)
+    {
+        for (size_t i = 1; i + 1 < face.size(); i++)
+        {
+            for (int corner : {face[0], face[i], face[i + 1]})
+            {
+                vertices_triangles.push_back(vertices[corner - 1][0]);
+                vertices_triangles.push_back(vertices[corner - 1][1]);
+                vertices_triangles.push_back(vertices[corner - 1][2]);
+            }
+        }
+    }
+
+    return vertices_triangles;
+}
+
+/**
+ * @brief Get the size of a file in bytes.
+ *
+ * @param filename Name of the file.
+ * @return size_t Size of the file.
+ */
+size_t fileSize(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    return file ? (size_t)file.tellg() : 0;
+}
+
+/**
+ * @brief Run a loader several times and print its throughput.
+ *
+ * @param name Name of the loader.
+ * @param filename File loaded.
+ * @param iterations Number of times that the file is loaded.
+ * @param loader Function that loads the file and return the number of floats loaded.
+ */
+void runLoader(const char *name, const std::string &filename, int iterations, const std::function<size_t()> &loader)
+{
+    size_t floats = loader(); // warm up the page cache
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        floats = loader();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    double seconds = elapsed.count() / iterations;
+    double megabytes = (double)fileSize(filename) / (1024.0 * 1024.0);
+    std::printf("  %-22s %10.3f ms %10.1f MB/s  (%zu floats)\n", name, seconds * 1000.0, megabytes / seconds, floats);
+}
+
+/**
+ * @brief Options that only parse the file (without cache, mesh processing nor sharing).
+ *
+ * @param memoryMap Memory-map the file.
+ * @param threads Number of threads of the parser.
+ * @return LoadOptions Options of the loader.
+ */
+LoadOptions parserOptions(bool memoryMap, unsigned int threads)
+{
+    LoadOptions options;
+    options.memoryMap = memoryMap;
+    options.threads = threads;
+    options.useCache = false;
+    options.optimize = false;
+    options.meshlets = false;
+    options.lodLevels = 0;
+    options.report = false;
+    options.shareGeometry = false;
+    return options;
+}
+
+int main(int argc, char **argv)
+{
+    int iterations = argc > 1 ? std::atoi(argv[1]) : 20;
+    std::vector<std::string> files;
+    for (int i = 2; i < argc; i++)
+        files.emplace_back(argv[i]);
+    if (files.empty())
+        files = {"models/Teapot.obj", "models/Gastly.obj"};
+
+    for (const std::string &filename : files)
+    {
+        std::printf("%s (%.2f MB, %d iterations)\n", filename.c_str(), fileSize(filename) / (1024.0 * 1024.0), iterations);
+
+        // vertex cache efficiency and levels of detail of the file
+        {
+            LoadOptions options;
+            options.useCache = false;
+            Model model;
+            model.loadFile(filename, options);
+        }
+
+        runLoader("legacy split()", filename, iterations, [&]() { return legacyLoadObj(filename).size(); });
+
+        runLoader("ObjParser + read()", filename, iterations, [&]() {
+            Model model;
+            model.loadFile(filename, parserOptions(false, 1));
+            return model.getVertexCount() * model.getVertexFloats();
+        });
+
+        runLoader("ObjParser + mmap", filename, iterations, [&]() {
+            Model model;
+            model.loadFile(filename, parserOptions(true, 1));
+            return model.getVertexCount() * model.getVertexFloats();
+        });
+
+        // parallel parser with an increasing number of threads
+        unsigned int maxThreads = (unsigned int)ThreadPool::shared().size() + 1;
+        for (unsigned int threads = 2; threads <= maxThreads; threads *= 2)
+        {
+            std::string name = "ObjParser + mmap x" + std::to_string(threads);
+            runLoader(name.c_str(), filename, iterations, [&]() {
+                Model model;
+                model.loadFile(filename, parserOptions(true, threads));
+                return model.getVertexCount() * model.getVertexFloats();
+            });
+        }
+
+        // parse and prepare the geometry (optimizations, meshlets and levels of detail)
+        runLoader("full processing", filename, iterations, [&]() {
+            LoadOptions options;
+            options.useCache = false;
+            options.report = false;
+            Model model;
+            model.loadFile(filename, options);
+            return model.getVertexCount() * model.getVertexFloats();
+        });
+
+        // other model of the scene already has the file loaded, the geometry is shared
+        {
+            LoadOptions options;
+            options.useCache = false;
+            options.report = false;
+            Model loaded;
+            loaded.loadFile(filename, options);
+            runLoader("shared geometry", filename, iterations, [&]() {
+                Model model;
+                model.loadFile(filename, options);
+                return model.getVertexCount() * model.getVertexFloats();
+            });
+        }
+
+        // binary cache: cold (process and write the cache) and warm (map the cache)
+        std::string cacheFile = MeshCache::cachePath(filename, "");
+        runLoader("rmesh cache cold", filename, iterations, [&]() {
+            std::remove(cacheFile.c_str());
+            LoadOptions options;
+            options.report = false;
+            Model model;
+            model.loadFile(filename, options);
+            return model.getVertexCount() * model.getVertexFloats();
+        });
+
+        // the copy simulates the upload to the GPU, in other case the pages would not be read
+        runLoader("rmesh cache warm", filename, iterations, [&]() {
+            Model model;
+            model.loadFile(filename);
+            const float *data = (const float *)model.getVertexData();
+            std::vector<float> upload(data, data + model.getVertexCount() * model.getVertexFloats());
+            return upload.size();
+        });
+    }
+
+    return 0;
+}
@@ -32,10 +32,10 @@
 
 // Global variables
 // --------------------------------------------------------------------------------------------
-Shader *ourShader;
-Shader *other_ourShader;
-Shader *juliaShader;
-Shader *mandelbrotShader;
+std::shared_ptr<Shader> ourShader;
+std::shared_ptr<Shader> other_ourShader;
+std::shared_ptr<Shader> juliaShader;
+std::shared_ptr<Shader> mandelbrotShader;
 
 Model *m1;
 Model *m2;
@@ -56,10 +56,14 @@ void Setup(Scene *scene, Render *render, Camera *camera, EventHandler *eventHand
 
     // build and compile our shader zprogram
     // ------------------------------------
-    ourShader = new Shader("./Shaders/VertexShader.glsl", "./Shaders/PixelShader.glsl");
-    other_ourShader = new Shader("./Shaders/VertexShader.glsl", "./Shaders/PixelShader.glsl");
-    juliaShader = new Shader("./Shaders/VertexShader.glsl", "./Shaders/PixelJulia.glsl");
-    mandelbrotShader = new Shader("./Shaders/VertexShader.glsl", "./Shaders/PixelMandelbrot.glsl");
+    // the shaders are compiled by the driver while the models are created, the models are
+    // drawn with a fallback shader until their shader is ready
+    ShaderRegistry::shared().setAsync(true);
+    // ourShader and other_ourShader share the program (see ShaderRegistry), each one keeps its own uniforms
+    ourShader = std::make_shared<Shader>("./Shaders/VertexShader.glsl", "./Shaders/PixelShader.glsl");
+    other_ourShader = std::make_shared<Shader>("./Shaders/VertexShader.glsl", "./Shaders/PixelShader.glsl");
+    juliaShader = std::make_shared<Shader>("./Shaders/VertexShader.glsl", "./Shaders/PixelJulia.glsl");
+    mandelbrotShader = std::make_shared<Shader>("./Shaders/VertexShader.glsl", "./Shaders/PixelMandelbrot.glsl");
 
     // CREATION OF MODELS TO DRAW
     // --------------------------
@@ -181,6 +185,7 @@ void Setup(Scene *scene, Render *render, Camera *camera, EventHandler *eventHand
         -0.5f,
     };
 
+    // the four cubes have the same vertex, they share one geometry in the CPU and the GPU
     m1 = new Model();
     m1->setVertex(std::vector<float>(vertices, vertices + sizeof(vertices) / sizeof(vertices[0])));
     m1->setShader(ourShader);
@@ -196,7 +201,8 @@ void Setup(Scene *scene, Render *render, Camera *camera, EventHandler *eventHand
     // create a third object
     m3 = new Model();
     m3->setVertex(std::vector<float>(vertices, vertices + sizeof(vertices) / sizeof(vertices[0])));
-    m3->setShader(mandelbrotShader);
+    // a permutation of the shader with less iterations (see Shader::getVariant), cheaper for the pixels of this cube
+    m3->setShader(mandelbrotShader->getVariant({{"MAXITER", "64"}}));
     scene->addModel(m3);
     m3->setPos(glm::vec3(-2, 0, 0));
 
@@ -207,12 +213,11 @@ void Setup(Scene *scene, Render *render, Camera *camera, EventHandler *eventHand
     scene->addModel(m4);
     m4->setPos(glm::vec3(0, 2, 0));
 
-    // create a fifth object
+    // create a fifth object (loaded in background, it appears when the file is loaded)
     m5 = new Model();
-    m5->loadFile("models/Teapot.obj"); // load vertex
     m5->setShader(other_ourShader);
-    scene->addModel(m5);
     m5->setPos(glm::vec3(5, 2, 0));
+    scene->addModelAsync(m5, "models/Teapot.obj");
 
     // add the axis to the scene
     scene->addAxis();
@@ -229,12 +234,7 @@ void Setup(Scene *scene, Render *render, Camera *camera, EventHandler *eventHand
 void onFrame(Scene *scene, Render *render, Camera *camera, EventHandler *eventHandler)
 {
     // put here code that will be excecuted in every frame
-
-    mandelbrotShader->setFloat("iTime", eventHandler->getLastFrame());
-    mandelbrotShader->setVec3("iResolution", glm::vec3(render->getWidth(), render->getHeight(), 1));
-
-    juliaShader->setFloat("iTime", eventHandler->getLastFrame());
-    juliaShader->setVec3("iResolution", glm::vec3(render->getWidth(), render->getHeight(), 1));
+    // (the time and the resolution are given to all the shaders by the scene, see FrameUniforms.h)
 }
 
 /**
@@ -5,6 +5,8 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <cstdint>
+#include <cstring>
 
 /**
  * @brief Split a string.
@@ -13,7 +15,7 @@
  * @param character Character to search for the split.
  * @return std::vector<std::string> vector with the elements of the string.
  */
-std::vector<std::string> split(std::string line, char character)
+inline std::vector<std::string> split(std::string line, char character)
 {
     std::vector<std::string> parsed_line;
     std::string word_analized = "";
@@ -38,4 +40,43 @@ std::vector<std::string> split(std::string line, char character)
     return parsed_line;
 }
 
+/**
+ * @brief Hash of a block of memory.
+ * 
+ * Fast 64 bits hash (the memory is processed in words of 8 bytes), used to detect changes in
+ * files and to identify equal contents. It is not a cryptographic hash.
+ * 
+ * @param data Pointer to the memory.
+ * @param size Number of bytes.
+ * @param seed Initial value of the hash, used to combine hashes.
+ * @return uint64_t Hash of the memory.
+ */
+inline uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0)
+{
+    const uint64_t prime = 0x9e3779b97f4a7c15ull;
+    const unsigned char *bytes = (const unsigned char *)data;
+    uint64_t hash = seed ^ (size * prime);
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, sizeof(word));
+        word *= 0xbf58476d1ce4e5b9ull;
+        word ^= word >> 31;
+        hash = ((hash ^ word) << 27 | (hash ^ word) >> 37) * prime;
+    }
+
+    // last bytes
+    uint64_t tail = 0;
+    for (size_t shift = 0; i < size; i++, shift += 8)
+        tail |= (uint64_t)bytes[i] << shift;
+    hash ^= tail * 0xbf58476d1ce4e5b9ull;
+
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
 #endif
\ No newline at end of file
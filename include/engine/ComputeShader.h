@@ -0,0 +1,408 @@
+/**
+ * @file ComputeShader.h
+ * @brief File with the compute shaders and the buffers and barriers they use.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * A compute shader is a program with only the compute stage, it runs in work groups of the
+ * size declared in the shader (layout(local_size_x = ...) in;). The data is given in shader
+ * storage buffers (StorageBuffer) and images, and the uniforms are set as in any Shader:
+ *
+ *      ComputeShader particles("./Shaders/Particles.glsl");
+ *      positions.bind(0);
+ *      particles.setFloat("deltaTime", dt);
+ *      particles.dispatchThreads(count);
+ *      MemoryBarriers::shared().wait(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);   // before drawing them
+ *
+ * The writes of a dispatch are only visible to the following commands after a barrier, the
+ * dispatches record the barriers their writes need in MemoryBarriers and each reader only
+ * waits for the ones that are pending (the barrier is not repeated if nothing was written).
+ *
+ * The compute shaders need OpenGL 4.3, see ComputeShader::isSupported.
+ */
+
+#ifndef RENDERENGINE_COMPUTESHADER_H
+#define RENDERENGINE_COMPUTESHADER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <Shader.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+/**
+ * @brief Barriers that the writes of the compute shaders need before being read.
+ *
+ * The engine uses a single object (see MemoryBarriers::shared()), it must be used from the
+ * OpenGL thread.
+ */
+class MemoryBarriers
+{
+private:
+    //! Barriers of the writes done since they were waited
+    GLbitfield pending = 0;
+
+    //! Number of glMemoryBarrier calls done
+    size_t barriers = 0;
+
+public:
+    /**
+     * @brief Get the barriers shared by the whole engine.
+     *
+     * @return MemoryBarriers& Barriers of the engine.
+     */
+    static MemoryBarriers &shared()
+    {
+        static MemoryBarriers memoryBarriers;
+        return memoryBarriers;
+    }
+
+    /**
+     * @brief Record that some memory was written by a shader.
+     *
+     * @param bits Barriers that the readers of the memory need (GL_SHADER_STORAGE_BARRIER_BIT, ...).
+     */
+    void written(GLbitfield bits)
+    {
+        this->pending |= bits;
+    }
+
+    /**
+     * @brief Wait for the writes that a reader needs, if they are pending.
+     *
+     * @param bits Barriers of the way the memory is going to be read (GL_ALL_BARRIER_BITS to wait for all).
+     */
+    void wait(GLbitfield bits)
+    {
+        GLbitfield needed = this->pending & bits;
+        if (needed == 0)
+            return;
+
+        glMemoryBarrier(needed);
+        this->pending &= ~needed;
+        this->barriers++;
+    }
+
+    /**
+     * @brief Get the Pending object
+     *
+     * @return GLbitfield Barriers of the writes that were not waited yet.
+     */
+    [[nodiscard]] GLbitfield getPending() const
+    {
+        return pending;
+    }
+
+    /**
+     * @brief Get the Barrier Count object
+     *
+     * @return size_t Number of glMemoryBarrier calls done.
+     */
+    [[nodiscard]] size_t getBarrierCount() const
+    {
+        return barriers;
+    }
+};
+
+/**
+ * @brief Shader storage buffer (the memory read and written by the compute shaders).
+ *
+ * The buffer is created in the first allocate, so the object can be created before the
+ * OpenGL context. The same buffer can be used as vertex buffer or as the parameters of an
+ * indirect dispatch or draw.
+ */
+class StorageBuffer
+{
+private:
+    //! OpenGL buffer (0 until the first allocate)
+    GLuint buffer = 0;
+
+    //! Size of the buffer in bytes
+    size_t size = 0;
+
+public:
+    StorageBuffer() = default;
+    StorageBuffer(const StorageBuffer &) = delete;
+    StorageBuffer &operator=(const StorageBuffer &) = delete;
+
+    /**
+     * @brief Give a size to the buffer (its previous content is lost).
+     *
+     * @param bytes Size of the buffer in bytes.
+     * @param data Initial content of the buffer (nullptr to leave it undefined).
+     * @param usage Usage hint of the buffer (GL_DYNAMIC_COPY if the GPU writes it and reads it).
+     */
+    void allocate(size_t bytes, const void *data = nullptr, GLenum usage = GL_DYNAMIC_COPY)
+    {
+        if (this->buffer == 0)
+            glGenBuffers(1, &this->buffer);
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)bytes, data, usage);
+        this->size = bytes;
+    }
+
+    /**
+     * @brief Write a range of the buffer from the CPU.
+     *
+     * @param offset Offset in bytes of the range.
+     * @param bytes Size of the range.
+     * @param data Content of the range.
+     */
+    void update(size_t offset, size_t bytes, const void *data)
+    {
+        MemoryBarriers::shared().wait(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes, data);
+    }
+
+    /**
+     * @brief Read a range of the buffer in the CPU (it waits for the GPU, do not use it every frame).
+     *
+     * @param offset Offset in bytes of the range.
+     * @param bytes Size of the range.
+     * @param data Memory where the content is copied.
+     */
+    void read(size_t offset, size_t bytes, void *data) const
+    {
+        MemoryBarriers::shared().wait(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, this->buffer);
+        glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, (GLintptr)offset, (GLsizeiptr)bytes, data);
+    }
+
+    /**
+     * @brief Bind the buffer to a binding point of the storage blocks (layout(std430, binding = N) buffer).
+     *
+     * @param binding Binding point.
+     */
+    void bind(GLuint binding) const
+    {
+        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, this->buffer);
+    }
+
+    /**
+     * @brief Bind a range of the buffer to a binding point of the storage blocks.
+     *
+     * @param binding Binding point.
+     * @param offset Offset in bytes of the range (multiple of GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT).
+     * @param bytes Size of the range.
+     */
+    void bindRange(GLuint binding, size_t offset, size_t bytes) const
+    {
+        glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, this->buffer, (GLintptr)offset, (GLsizeiptr)bytes);
+    }
+
+    /**
+     * @brief Delete the buffer of the GPU.
+     *
+     * It is not done by the destructor because the objects usually outlive the OpenGL
+     * context, it must be called while the context exists.
+     */
+    void release()
+    {
+        if (this->buffer != 0)
+            glDeleteBuffers(1, &this->buffer);
+        this->buffer = 0;
+        this->size = 0;
+    }
+
+    /**
+     * @brief Get the Buffer object
+     *
+     * @return GLuint OpenGL buffer (0 if it is not allocated).
+     */
+    [[nodiscard]] GLuint getBuffer() const
+    {
+        return buffer;
+    }
+
+    /**
+     * @brief Get the Size object
+     *
+     * @return size_t Size of the buffer in bytes.
+     */
+    [[nodiscard]] size_t getSize() const
+    {
+        return size;
+    }
+};
+
+/**
+ * @brief Parameters of an indirect dispatch, as they are stored in the buffer.
+ *
+ */
+struct DispatchIndirectCommand
+{
+    //! Number of work groups in x
+    GLuint groupsX;
+
+    //! Number of work groups in y
+    GLuint groupsY;
+
+    //! Number of work groups in z
+    GLuint groupsZ;
+};
+
+/**
+ * @brief Program with only the compute stage.
+ *
+ * It is built as the other shaders (preprocessed, shared by the registry and stored in the
+ * binary cache) and its uniforms are set with the same methods. Each dispatch uses the
+ * program, uploads the uniforms that changed and waits for the writes of the previous
+ * dispatches that it can read.
+ */
+class ComputeShader : public Shader
+{
+private:
+    //! Size of the work groups declared in the shader (0 until the program is ready)
+    glm::uvec3 workGroupSize = glm::uvec3(0);
+
+    //! Barriers that the writes of the dispatches need (the readers only wait for the ones of their kind)
+    GLbitfield writes = GL_ALL_BARRIER_BITS;
+
+    /**
+     * @brief Prepare a dispatch: use the program, upload the uniforms and wait for the previous writes.
+     *
+     */
+    void begin()
+    {
+        this->use();
+        this->updateUniform();
+        MemoryBarriers::shared().wait(GL_SHADER_STORAGE_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_UNIFORM_BARRIER_BIT);
+    }
+
+public:
+    /**
+     * @brief Construct a new Compute Shader object
+     *
+     * @param computePath Path to the code of the compute shader.
+     * @param shaderDefines Defines added to the code (see ShaderPreprocessor).
+     */
+    explicit ComputeShader(const char *computePath, const ShaderDefines &shaderDefines = ShaderDefines())
+        : Shader(nullptr, nullptr, nullptr, computePath, shaderDefines)
+    {
+        if (!isSupported())
+            std::cout << "ERROR::COMPUTE_SHADER::NOT_SUPPORTED (OpenGL 4.3 is needed)" << std::endl;
+    }
+
+    /**
+     * @brief Check if the context can run compute shaders.
+     *
+     * @return true If the context is OpenGL 4.3 or newer.
+     */
+    static bool isSupported()
+    {
+        return GLAD_GL_VERSION_4_3 != 0;
+    }
+
+    /**
+     * @brief Run the shader in a grid of work groups.
+     *
+     * @param groupsX Number of work groups in x.
+     * @param groupsY Number of work groups in y.
+     * @param groupsZ Number of work groups in z.
+     */
+    void dispatch(GLuint groupsX, GLuint groupsY = 1, GLuint groupsZ = 1)
+    {
+        if (groupsX == 0 || groupsY == 0 || groupsZ == 0)
+            return;
+
+        this->begin();
+        glDispatchCompute(groupsX, groupsY, groupsZ);
+        MemoryBarriers::shared().written(this->writes);
+    }
+
+    /**
+     * @brief Run the shader in enough work groups to have a thread per element.
+     *
+     * The threads outside the size must be discarded by the shader (the last groups can be incomplete).
+     *
+     * @param threadsX Number of threads in x.
+     * @param threadsY Number of threads in y.
+     * @param threadsZ Number of threads in z.
+     */
+    void dispatchThreads(GLuint threadsX, GLuint threadsY = 1, GLuint threadsZ = 1)
+    {
+        glm::uvec3 size = this->getWorkGroupSize();
+        if (size.x == 0)
+            return;
+
+        this->dispatch((threadsX + size.x - 1) / size.x, (threadsY + size.y - 1) / size.y, (threadsZ + size.z - 1) / size.z);
+    }
+
+    /**
+     * @brief Run the shader with the number of work groups stored in a buffer (written by other dispatch for example).
+     *
+     * @param parameters Buffer with the parameters (DispatchIndirectCommand).
+     * @param offset Offset in bytes of the parameters in the buffer (multiple of 4).
+     */
+    void dispatchIndirect(const StorageBuffer &parameters, size_t offset = 0)
+    {
+        this->begin();
+        MemoryBarriers::shared().wait(GL_COMMAND_BARRIER_BIT);
+        glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, parameters.getBuffer());
+        glDispatchComputeIndirect((GLintptr)offset);
+        MemoryBarriers::shared().written(this->writes);
+    }
+
+    /**
+     * @brief Bind a level of a texture to an image unit (layout(binding = N, format) uniform image2D).
+     *
+     * @param unit Image unit.
+     * @param texture Texture.
+     * @param access GL_READ_ONLY, GL_WRITE_ONLY or GL_READ_WRITE.
+     * @param format Format of the image in the shader (GL_RGBA8, GL_R32F, ...).
+     * @param level Level of the texture.
+     */
+    static void bindImage(GLuint unit, GLuint texture, GLenum access, GLenum format, GLint level = 0)
+    {
+        glBindImageTexture(unit, texture, level, GL_TRUE, 0, access, format);
+    }
+
+    /**
+     * @brief Get the Work Group Size object
+     *
+     * @return glm::uvec3 Size of the work groups declared in the shader (it waits for the program to be ready).
+     */
+    glm::uvec3 getWorkGroupSize()
+    {
+        if (this->workGroupSize.x == 0)
+        {
+            this->wait();
+            GLint size[3] = {0, 0, 0};
+            glGetProgramiv(this->ID, GL_COMPUTE_WORK_GROUP_SIZE, size);
+            this->workGroupSize = glm::uvec3(size[0], size[1], size[2]);
+        }
+
+        return workGroupSize;
+    }
+
+    /**
+     * @brief Get the Writes object
+     *
+     * @return GLbitfield Barriers that the writes of the dispatches need.
+     */
+    [[nodiscard]] GLbitfield getWrites() const
+    {
+        return writes;
+    }
+
+    /**
+     * @brief Set the Writes object
+     *
+     * By default the results can be read in any way (GL_ALL_BARRIER_BITS), each reader
+     * only waits for the barrier of its kind. A shader that only writes memory read by other
+     * dispatches can use GL_SHADER_STORAGE_BARRIER_BIT, so the draws do not wait for it.
+     *
+     * @param bits Barriers that the writes of the dispatches need.
+     */
+    void setWrites(GLbitfield bits)
+    {
+        this->writes = bits;
+    }
+};
+
+#endif //RENDERENGINE_COMPUTESHADER_H
@@ -0,0 +1,66 @@
+/**
+ * @file FrameUniforms.h
+ * @brief File with the uniforms that are the same for all the shaders in a frame.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * The camera matrices, the time and the resolution are written once per frame by the Scene in
+ * a uniform buffer bound to FRAME_BLOCK_BINDING. The shaders read them including the block of
+ * Shaders/FrameBlock.glsl (the Shader binds it after linking the program), instead of having
+ * their own uniforms set for each shader.
+ */
+
+#ifndef RENDERENGINE_FRAMEUNIFORMS_H
+#define RENDERENGINE_FRAMEUNIFORMS_H
+
+#include <UniformBuffer.h>
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <cstdint>
+
+//! Binding point of the uniform buffer of the frame
+const unsigned int FRAME_BLOCK_BINDING = 0;
+
+//! Name of the uniform block of the frame in the shaders
+const char *const FRAME_BLOCK_NAME = "FrameBlock";
+
+/**
+ * @brief Values of the uniform block of the frame, with the std140 layout of the block of Shaders/FrameBlock.glsl.
+ *
+ * The alignment pads the struct to the size of the block (multiple of 16 bytes).
+ */
+struct alignas(16) FrameUniforms
+{
+    //! View matrix of the camera
+    glm::mat4 view;
+
+    //! Projection matrix of the camera
+    glm::mat4 projection;
+
+    //! projection * view
+    glm::mat4 viewProjection;
+
+    //! Position of the camera in world coordinates (w is 1)
+    glm::vec4 cameraPosition;
+
+    //! Width and height of the screen in pixels and aspect of the pixels (1)
+    glm::vec3 resolution;
+
+    //! Time since the start of the program in seconds
+    float time;
+
+    //! Time of the last frame in seconds
+    float deltaTime;
+
+    //! Number of the frame
+    int32_t frame;
+};
+
+static_assert(Std140Layout<glm::mat4, glm::mat4, glm::mat4, glm::vec4, glm::vec3, float, float, int32_t>::check(
+                  sizeof(FrameUniforms), offsetof(FrameUniforms, view), offsetof(FrameUniforms, projection),
+                  offsetof(FrameUniforms, viewProjection), offsetof(FrameUniforms, cameraPosition), offsetof(FrameUniforms, resolution),
+                  offsetof(FrameUniforms, time), offsetof(FrameUniforms, deltaTime), offsetof(FrameUniforms, frame)),
+              "FrameUniforms must follow the std140 layout of the block of Shaders/FrameBlock.glsl");
+
+#endif //RENDERENGINE_FRAMEUNIFORMS_H
@@ -0,0 +1,352 @@
+/**
+ * @file Frustum.h
+ * @brief File with the view frustum used to cull the geometry that is not visible.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * The models of the scene are culled in batches by FrustumCuller: their bounds are kept in
+ * arrays by component (structure of arrays), so each plane is tested against consecutive
+ * floats in loops without branches that the compiler can vectorize. Each object remembers
+ * the plane that rejected it the last time, it is tested first in the next frame and
+ * usually rejects it again with a single test (the camera moves little between frames).
+ */
+
+#ifndef RENDERENGINE_FRUSTUM_H
+#define RENDERENGINE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Planes of the view frustum.
+ *
+ * The planes point inside the frustum and are normalized, so the dot product with a point
+ * is its signed distance to the plane.
+ */
+struct Frustum
+{
+    //! Planes left, right, bottom, top, near and far (normal in xyz and distance in w)
+    glm::vec4 planes[6];
+
+    /**
+     * @brief Extract the planes of a projection matrix (Gribb and Hartmann).
+     *
+     * If the matrix is projection * view * model the planes are in model coordinates (the
+     * model matrix must not have scale for the distances to be correct).
+     *
+     * @param matrix Matrix that transforms to clip coordinates.
+     * @return Frustum Frustum of the matrix.
+     */
+    static Frustum fromMatrix(const glm::mat4 &matrix)
+    {
+        // glm matrices are stored by columns, the rows are needed
+        glm::mat4 rows = glm::transpose(matrix);
+
+        Frustum frustum;
+        frustum.planes[0] = rows[3] + rows[0];
+        frustum.planes[1] = rows[3] - rows[0];
+        frustum.planes[2] = rows[3] + rows[1];
+        frustum.planes[3] = rows[3] - rows[1];
+        frustum.planes[4] = rows[3] + rows[2];
+        frustum.planes[5] = rows[3] - rows[2];
+
+        for (glm::vec4 &plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+
+        return frustum;
+    }
+
+    /**
+     * @brief Check if a sphere is (at least partially) inside the frustum.
+     *
+     * @param center Center of the sphere.
+     * @param radius Radius of the sphere.
+     * @return true If the sphere can be visible.
+     */
+    [[nodiscard]] bool sphereVisible(const glm::vec3 &center, float radius) const
+    {
+        for (const glm::vec4 &plane : planes)
+        {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        }
+
+        return true;
+    }
+};
+
+/**
+ * @brief Statistics of the last culling done by a FrustumCuller.
+ *
+ */
+struct CullingStatistics
+{
+    //! Number of objects inside (or partially inside) the frustum
+    size_t visible = 0;
+
+    //! Number of objects outside the frustum
+    size_t culled = 0;
+
+    //! Number of objects rejected by the plane that rejected them in the previous culling
+    size_t coherent = 0;
+
+    //! Number of objects tested against all the planes
+    size_t fullTests = 0;
+};
+
+/**
+ * @brief Culling of a set of objects against a frustum with their bounds in arrays.
+ *
+ * Each object has a bounding box and a bounding sphere with the same center (in world
+ * coordinates). Against each plane the smaller of the two projected radius is used, so the
+ * test is as tight as the tighter volume in the direction of the plane.
+ *
+ * The culling is done in two passes:
+ *
+ *  - All the objects are tested against the plane that rejected them the last time.
+ *  - The objects that pass are copied to consecutive arrays and tested against the six
+ *    planes, one plane at a time for all of them.
+ *
+ * The objects are identified by their index, use remove when an object is deleted so the
+ * next ones keep their plane.
+ */
+class FrustumCuller
+{
+private:
+    //! Value of failing for the objects that are inside all the planes
+    static constexpr uint32_t NO_PLANE = 6;
+
+    //! Center of the bounds of each object
+    std::vector<float> centerX, centerY, centerZ;
+
+    //! Half size of the bounding box of each object
+    std::vector<float> extentX, extentY, extentZ;
+
+    //! Radius of the bounding sphere of each object
+    std::vector<float> radius;
+
+    //! Plane that rejected each object the last time (0 if it was visible)
+    std::vector<uint8_t> lastPlane;
+
+    //! Result of the last culling (1 if the object can be visible)
+    std::vector<uint8_t> visible;
+
+    //! Indices of the objects that pass the first test (reused between cullings)
+    std::vector<uint32_t> candidates;
+
+    //! Bounds of the candidates, consecutive (reused between cullings)
+    std::vector<float> candidateBounds[7];
+
+    //! First plane that rejects each candidate, NO_PLANE if none (reused between cullings)
+    std::vector<uint32_t> failing;
+
+    //! Statistics of the last culling
+    CullingStatistics statistics;
+
+    /**
+     * @brief Check if some bounds are outside a plane.
+     *
+     * @param plane Plane (pointing inside the frustum).
+     * @param absNormal Absolute value of the normal of the plane.
+     * @return true If the bounds are completely outside the plane.
+     */
+    static bool outside(const glm::vec4 &plane, const glm::vec3 &absNormal, float x, float y, float z, float ex, float ey, float ez,
+                        float r)
+    {
+        float distance = plane.x * x + plane.y * y + plane.z * z + plane.w;
+        float boxRadius = absNormal.x * ex + absNormal.y * ey + absNormal.z * ez;
+        return distance < -std::min(r, boxRadius);
+    }
+
+public:
+    /**
+     * @brief Change the number of objects (the new ones are visible until their bounds are set).
+     *
+     * @param count Number of objects.
+     */
+    void resize(size_t count)
+    {
+        for (std::vector<float> *values : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius})
+            values->resize(count, 0.0f);
+        this->lastPlane.resize(count, 0);
+        this->visible.resize(count, 1);
+    }
+
+    /**
+     * @brief Remove an object, the following ones are moved one position.
+     *
+     * @param index Index of the object.
+     */
+    void remove(size_t index)
+    {
+        if (index >= this->radius.size())
+            return;
+
+        for (std::vector<float> *values : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius})
+            values->erase(values->begin() + index);
+        this->lastPlane.erase(this->lastPlane.begin() + index);
+        this->visible.erase(this->visible.begin() + index);
+    }
+
+    /**
+     * @brief Set the bounds of an object from its local bounds and its model matrix.
+     *
+     * The box is transformed to the box that contains it in world coordinates (Arvo), and the
+     * radius of the sphere is scaled by the largest scale of the matrix.
+     *
+     * @param index Index of the object (less than the number of objects).
+     * @param matrix Model matrix of the object.
+     * @param boundsMin Minimum corner of the bounding box (local coordinates).
+     * @param boundsMax Maximum corner of the bounding box (local coordinates).
+     * @param sphereRadius Radius of the bounding sphere centered in the box (local coordinates).
+     */
+    void setBounds(size_t index, const glm::mat4 &matrix, const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, float sphereRadius)
+    {
+        glm::vec3 center = glm::vec3(matrix * glm::vec4((boundsMin + boundsMax) * 0.5f, 1.0f));
+        glm::vec3 half = (boundsMax - boundsMin) * 0.5f;
+        glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+        glm::vec3 extent = absolute * half;
+        float scale = std::max(glm::length(glm::vec3(matrix[0])), std::max(glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2]))));
+
+        this->centerX[index] = center.x;
+        this->centerY[index] = center.y;
+        this->centerZ[index] = center.z;
+        this->extentX[index] = extent.x;
+        this->extentY[index] = extent.y;
+        this->extentZ[index] = extent.z;
+        this->radius[index] = sphereRadius * scale;
+    }
+
+    /**
+     * @brief Cull all the objects against a frustum (see isVisible for the results).
+     *
+     * @param frustum Frustum in world coordinates.
+     */
+    void cull(const Frustum &frustum)
+    {
+        size_t count = this->radius.size();
+        float planeX[6], planeY[6], planeZ[6], planeW[6];
+        glm::vec3 absNormal[6];
+        for (int p = 0; p < 6; p++)
+        {
+            planeX[p] = frustum.planes[p].x;
+            planeY[p] = frustum.planes[p].y;
+            planeZ[p] = frustum.planes[p].z;
+            planeW[p] = frustum.planes[p].w;
+            absNormal[p] = glm::abs(glm::vec3(frustum.planes[p]));
+        }
+
+        // first pass, each object against the plane that rejected it the last time
+        this->candidates.clear();
+        this->statistics = CullingStatistics();
+        for (size_t i = 0; i < count; i++)
+        {
+            uint8_t p = this->lastPlane[i];
+            if (outside(frustum.planes[p], absNormal[p], this->centerX[i], this->centerY[i], this->centerZ[i], this->extentX[i],
+                        this->extentY[i], this->extentZ[i], this->radius[i]))
+            {
+                this->visible[i] = 0;
+                this->statistics.coherent++;
+                continue;
+            }
+            this->candidates.push_back((uint32_t)i);
+        }
+
+        // the bounds of the candidates are copied to consecutive arrays
+        size_t candidateCount = this->candidates.size();
+        const std::vector<float> *sources[7] = {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius};
+        for (int component = 0; component < 7; component++)
+        {
+            std::vector<float> &values = this->candidateBounds[component];
+            values.resize(candidateCount);
+            for (size_t k = 0; k < candidateCount; k++)
+                values[k] = (*sources[component])[this->candidates[k]];
+        }
+        this->failing.assign(candidateCount, NO_PLANE);
+
+        // second pass, one plane at a time for all the candidates (without branches, so it can be vectorized)
+        const float *x = this->candidateBounds[0].data();
+        const float *y = this->candidateBounds[1].data();
+        const float *z = this->candidateBounds[2].data();
+        const float *ex = this->candidateBounds[3].data();
+        const float *ey = this->candidateBounds[4].data();
+        const float *ez = this->candidateBounds[5].data();
+        const float *r = this->candidateBounds[6].data();
+        uint32_t *failed = this->failing.data();
+        for (uint32_t p = 0; p < 6; p++)
+        {
+            float nx = planeX[p], ny = planeY[p], nz = planeZ[p], w = planeW[p];
+            float ax = absNormal[p].x, ay = absNormal[p].y, az = absNormal[p].z;
+            for (size_t k = 0; k < candidateCount; k++)
+            {
+                float distance = nx * x[k] + ny * y[k] + nz * z[k] + w;
+                float boxRadius = ax * ex[k] + ay * ey[k] + az * ez[k];
+                float limit = r[k] < boxRadius ? r[k] : boxRadius;
+                failed[k] = (distance < -limit && failed[k] == NO_PLANE) ? p : failed[k];
+            }
+        }
+
+        for (size_t k = 0; k < candidateCount; k++)
+        {
+            uint32_t i = this->candidates[k];
+            bool inside = failed[k] == NO_PLANE;
+            this->visible[i] = inside ? 1 : 0;
+            if (!inside)
+                this->lastPlane[i] = (uint8_t)failed[k];
+            this->statistics.visible += inside ? 1 : 0;
+        }
+
+        this->statistics.fullTests = candidateCount;
+        this->statistics.culled = count - this->statistics.visible;
+    }
+
+    /**
+     * @brief Check if an object was visible in the last culling.
+     *
+     * @param index Index of the object.
+     * @return true If the object is inside (or partially inside) the frustum.
+     */
+    [[nodiscard]] bool isVisible(size_t index) const
+    {
+        return visible[index] != 0;
+    }
+
+    /**
+     * @brief Get the center of the bounds of an object.
+     *
+     * @param index Index of the object.
+     * @return glm::vec3 Center of the bounds in world coordinates.
+     */
+    [[nodiscard]] glm::vec3 getCenter(size_t index) const
+    {
+        return glm::vec3(centerX[index], centerY[index], centerZ[index]);
+    }
+
+    /**
+     * @brief Get the number of objects.
+     *
+     * @return size_t Number of objects.
+     */
+    [[nodiscard]] size_t size() const
+    {
+        return radius.size();
+    }
+
+    /**
+     * @brief Get the statistics of the last culling.
+     *
+     * @return const CullingStatistics& Number of objects visible, culled, rejected by their last plane and fully tested.
+     */
+    [[nodiscard]] const CullingStatistics &getStatistics() const
+    {
+        return statistics;
+    }
+};
+
+#endif //RENDERENGINE_FRUSTUM_H
@@ -0,0 +1,415 @@
+/**
+ * @file GeometryRegistry.h
+ * @brief File with the geometry of the models and the registry that shares it between them.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * Scenes usually repeat the same mesh many times (props, the cubes of the setup...). The
+ * models that have the same geometry share a single Geometry object, so the vertex and the
+ * indices are stored only once in the CPU and the Scene uploads them only once to the GPU.
+ */
+
+#ifndef RENDERENGINE_GEOMETRYREGISTRY_H
+#define RENDERENGINE_GEOMETRYREGISTRY_H
+
+#include <MeshCache.h>
+#include <MeshOptimizer.h>
+#include <MeshSimplifier.h>
+#include <VertexLayout.h>
+#include <Utils.h>
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Geometry of a model (vertex, indices, meshlets and levels of detail).
+ *
+ * The vertex are in vertex (float format), in packed (quantized formats) or in the mapped
+ * binary cache. A geometry that is in the GeometryRegistry can be used by several models at
+ * the same time, so it must not be modified (the models copy it before changing it).
+ */
+struct Geometry
+{
+    //! vector of vertex to be draw (interleaved attributes, described by the layout)
+    std::vector<float> vertex;
+
+    //! format of the vertex
+    VertexLayout layout = VertexLayout::floats();
+
+    //! quantized vertex (only used when the format of the layout is not VERTEX_FORMAT_FLOAT, then vertex is empty)
+    std::vector<uint8_t> packed;
+
+    //! vector with the index of the vertex used by each corner of the primitives (empty if the vertex are not indexed)
+    std::vector<unsigned int> indices;
+
+    //! geometry of the binary cache when it is loaded from it (vertex and indices are empty)
+    MeshCacheView cache;
+
+    //! clusters of consecutive triangles of the index buffer (empty if not used)
+    std::vector<Meshlet> meshlets;
+
+    //! levels of detail, ranges of the index buffer (empty if there is only the original geometry)
+    std::vector<MeshLod> lods;
+
+    //! minimum corner of the bounding box of the vertex
+    glm::vec3 boundsMin = glm::vec3(0);
+
+    //! maximum corner of the bounding box of the vertex
+    glm::vec3 boundsMax = glm::vec3(0);
+
+    //! radius of the bounding sphere of the vertex, centered in the bounding box (smaller than half its diagonal)
+    float boundsRadius = 0.0f;
+
+    //! true when the geometry is in the registry (it is shared and can not be modified)
+    bool registered = false;
+
+    /**
+     * @brief Get the pointer to the vertex.
+     *
+     * @return const void* Pointer to the vertex (vertexCount vertex of layout.stride bytes).
+     */
+    [[nodiscard]] const void *vertexData() const
+    {
+        if (cache.vertex != nullptr)
+            return cache.vertex;
+
+        return layout.format != VERTEX_FORMAT_FLOAT ? (const void *)packed.data() : (const void *)vertex.data();
+    }
+
+    /**
+     * @brief Get the number of vertex.
+     *
+     * @return size_t Number of vertex.
+     */
+    [[nodiscard]] size_t vertexCount() const
+    {
+        if (cache.header != nullptr)
+            return (size_t)cache.header->vertexCount;
+
+        return layout.format != VERTEX_FORMAT_FLOAT ? packed.size() / layout.stride : vertex.size() / (layout.stride / sizeof(float));
+    }
+
+    /**
+     * @brief Get the number of indices (of all the levels of detail).
+     *
+     * @return size_t Number of indices (0 if the vertex are not indexed).
+     */
+    [[nodiscard]] size_t indexCount() const
+    {
+        return cache.header != nullptr ? (size_t)cache.header->indexCount : indices.size();
+    }
+
+    /**
+     * @brief Get the type of the indices to use in the GPU.
+     *
+     * @return GLenum GL_UNSIGNED_SHORT (65536 vertex or less) or GL_UNSIGNED_INT.
+     */
+    [[nodiscard]] GLenum indexType() const
+    {
+        return vertexCount() <= 65536 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+    }
+
+    /**
+     * @brief Get the indices in the format used in the GPU (see indexType).
+     *
+     * @param buffer Buffer used to store the indices if they must be converted to 16 bits.
+     * @return const void* Pointer to the indices.
+     */
+    const void *indexData(std::vector<GLushort> &buffer) const
+    {
+        if (cache.header != nullptr)
+            return cache.indices;
+
+        if (indexType() == GL_UNSIGNED_SHORT)
+        {
+            buffer.assign(indices.begin(), indices.end());
+            return buffer.data();
+        }
+
+        return indices.data();
+    }
+
+    /**
+     * @brief Get the size in bytes of the geometry in the GPU (vertex and indices).
+     *
+     * @return size_t Number of bytes.
+     */
+    [[nodiscard]] size_t gpuBytes() const
+    {
+        size_t indexSize = indexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        return vertexCount() * layout.stride + indexCount() * indexSize;
+    }
+
+    /**
+     * @brief Hash of the content of the geometry.
+     *
+     * @return uint64_t Hash of the format, the vertex, the indices, the meshlets and the levels of detail.
+     */
+    [[nodiscard]] uint64_t contentHash() const
+    {
+        uint32_t format[3] = {layout.mask(), (uint32_t)layout.format, (uint32_t)layout.stride};
+        uint64_t hash = hashBytes(format, sizeof(format));
+        hash = hashBytes(vertexData(), vertexCount() * layout.stride, hash);
+        hash = hashBytes(indices.data(), indices.size() * sizeof(unsigned int), hash);
+        if (cache.header != nullptr)
+            hash = hashBytes(cache.indices, cache.header->indexCount * cache.header->indexSize, hash);
+        hash = hashBytes(meshlets.data(), meshlets.size() * sizeof(Meshlet), hash);
+        return hashBytes(lods.data(), lods.size() * sizeof(MeshLod), hash);
+    }
+
+    /**
+     * @brief Compare the content of two geometries (to discard the collisions of contentHash).
+     *
+     * @param other Geometry to compare with.
+     * @return true If both have the same format, vertex, indices, meshlets and levels of detail.
+     */
+    [[nodiscard]] bool sameContent(const Geometry &other) const
+    {
+        if (layout.mask() != other.layout.mask() || layout.format != other.layout.format || layout.stride != other.layout.stride ||
+            vertexCount() != other.vertexCount() || indexCount() != other.indexCount() || indexType() != other.indexType() ||
+            meshlets.size() != other.meshlets.size() || lods.size() != other.lods.size())
+            return false;
+
+        std::vector<GLushort> buffer;
+        std::vector<GLushort> otherBuffer;
+        size_t indexSize = indexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        return std::memcmp(vertexData(), other.vertexData(), vertexCount() * layout.stride) == 0 &&
+               std::memcmp(indexData(buffer), other.indexData(otherBuffer), indexCount() * indexSize) == 0 &&
+               std::memcmp(meshlets.data(), other.meshlets.data(), meshlets.size() * sizeof(Meshlet)) == 0 &&
+               std::memcmp(lods.data(), other.lods.data(), lods.size() * sizeof(MeshLod)) == 0;
+    }
+};
+
+/**
+ * @brief Registry of the geometries used by the models.
+ *
+ * The geometries are found by the hash of their content (models built with setVertex and
+ * setIndices) or by the path of the file and the options used to load it (loadFile), so
+ * loading the same file again does not parse nor process it. The registry does not keep the
+ * geometries alive, they are removed when the last model that uses them is destroyed.
+ *
+ * The engine uses a single registry (see GeometryRegistry::shared()), it can be used from
+ * the threads that load the models in background.
+ */
+class GeometryRegistry
+{
+private:
+    //! Geometries by hash of their content
+    std::unordered_map<uint64_t, std::weak_ptr<Geometry>> byContent;
+
+    //! Geometries by file (path and options of the load)
+    std::unordered_map<std::string, std::weak_ptr<Geometry>> byFile;
+
+    /**
+     * @brief Load of a file in progress.
+     *
+     */
+    struct FileLoad
+    {
+        //! Fulfilled with the geometry of the file when the load ends (nullptr if it failed)
+        std::promise<std::shared_ptr<Geometry>> promise;
+
+        //! Result of the load, waited by the other loads of the same file
+        std::shared_future<std::shared_ptr<Geometry>> result;
+    };
+
+    //! Loads of files in progress by key of the file
+    std::unordered_map<std::string, FileLoad> loading;
+
+    //! Number of entries that triggers the removal of the expired ones
+    size_t purgeThreshold = 64;
+
+    //! Mutex protecting the maps
+    std::mutex mutex;
+
+    /**
+     * @brief End the load of a file in progress, the loads waiting for it get the geometry.
+     *
+     * The mutex must be locked.
+     *
+     * @param key Key of the file.
+     * @param geometry Geometry of the file (nullptr if the load failed).
+     */
+    void endFile(const std::string &key, const std::shared_ptr<Geometry> &geometry)
+    {
+        auto it = this->loading.find(key);
+        if (it == this->loading.end())
+            return;
+
+        it->second.promise.set_value(geometry);
+        this->loading.erase(it);
+    }
+
+    /**
+     * @brief Remove the entries of geometries that are no longer used, when there are too many.
+     *
+     * The threshold doubles after each purge, so the cost is amortized between the insertions.
+     */
+    void purge()
+    {
+        if (this->byContent.size() + this->byFile.size() < this->purgeThreshold)
+            return;
+
+        for (auto it = this->byContent.begin(); it != this->byContent.end();)
+            it = it->second.expired() ? this->byContent.erase(it) : std::next(it);
+        for (auto it = this->byFile.begin(); it != this->byFile.end();)
+            it = it->second.expired() ? this->byFile.erase(it) : std::next(it);
+
+        this->purgeThreshold = std::max<size_t>(64, 2 * (this->byContent.size() + this->byFile.size()));
+    }
+
+public:
+    /**
+     * @brief Get the registry shared by the whole engine.
+     *
+     * @return GeometryRegistry& Registry of the engine.
+     */
+    static GeometryRegistry &shared()
+    {
+        static GeometryRegistry registry;
+        return registry;
+    }
+
+    /**
+     * @brief Get the geometry with the same content, registering this one if there is not any.
+     *
+     * @param geometry Geometry to share (it must not be modified after this call).
+     * @return std::shared_ptr<Geometry> Registered geometry with the same content (geometry itself if it is new).
+     */
+    std::shared_ptr<Geometry> share(const std::shared_ptr<Geometry> &geometry)
+    {
+        uint64_t hash = geometry->contentHash();
+
+        std::lock_guard<std::mutex> lock(this->mutex);
+        std::shared_ptr<Geometry> existing = this->byContent[hash].lock();
+        if (existing == geometry)
+            return geometry;
+
+        if (existing != nullptr)
+        {
+            // two different geometries with the same hash, the new one is not shared
+            if (existing->sameContent(*geometry))
+                return existing;
+            return geometry;
+        }
+
+        this->purge();
+        geometry->registered = true;
+        this->byContent[hash] = geometry;
+        return geometry;
+    }
+
+    /**
+     * @brief Find the geometry loaded from a file.
+     *
+     * @param key Key of the file (path and options of the load).
+     * @return std::shared_ptr<Geometry> Geometry of the file (nullptr if it is not loaded).
+     */
+    std::shared_ptr<Geometry> findFile(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->byFile.find(key);
+        return it != this->byFile.end() ? it->second.lock() : nullptr;
+    }
+
+    /**
+     * @brief Register the geometry loaded from a file.
+     *
+     * If the file was loaded meanwhile by other thread the geometry of that load is used.
+     *
+     * @param key Key of the file (path and options of the load).
+     * @param geometry Geometry loaded from the file (it must not be modified after this call).
+     * @return std::shared_ptr<Geometry> Registered geometry of the file.
+     */
+    std::shared_ptr<Geometry> addFile(const std::string &key, const std::shared_ptr<Geometry> &geometry)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        std::shared_ptr<Geometry> existing = this->byFile[key].lock();
+        if (existing != nullptr)
+        {
+            this->endFile(key, existing);
+            return existing;
+        }
+
+        this->purge();
+        geometry->registered = true;
+        this->byFile[key] = geometry;
+        this->endFile(key, geometry);
+        return geometry;
+    }
+
+    /**
+     * @brief Start the load of a file, unless it is already loaded or being loaded.
+     *
+     * Only the first of the loads of the same file at the same time reads it, it must end
+     * with addFile (or with cancelFile if it fails). The others get the result of that load
+     * in pending, so they do not parse the file nor write its cache at the same time.
+     *
+     * @param key Key of the file (path and options of the load).
+     * @param pending Geometry of the file when this method returns false (nullptr if the load failed).
+     * @return true If the caller must load the file.
+     */
+    bool beginFile(const std::string &key, std::shared_future<std::shared_ptr<Geometry>> &pending)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        auto loaded = this->byFile.find(key);
+        std::shared_ptr<Geometry> existing = loaded != this->byFile.end() ? loaded->second.lock() : nullptr;
+        if (existing != nullptr)
+        {
+            std::promise<std::shared_ptr<Geometry>> ready;
+            ready.set_value(existing);
+            pending = ready.get_future().share();
+            return false;
+        }
+
+        auto it = this->loading.find(key);
+        if (it != this->loading.end())
+        {
+            pending = it->second.result;
+            return false;
+        }
+
+        FileLoad &load = this->loading[key];
+        load.result = load.promise.get_future().share();
+        return true;
+    }
+
+    /**
+     * @brief End a load started with beginFile that failed.
+     *
+     * @param key Key of the file.
+     */
+    void cancelFile(const std::string &key)
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->endFile(key, nullptr);
+    }
+
+    /**
+     * @brief Get the number of geometries in the registry that are being used.
+     *
+     * @return size_t Number of geometries alive (a geometry registered by content and by file counts twice).
+     */
+    size_t size()
+    {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        size_t count = 0;
+        for (const auto &entry : this->byContent)
+            count += entry.second.expired() ? 0 : 1;
+        for (const auto &entry : this->byFile)
+            count += entry.second.expired() ? 0 : 1;
+        return count;
+    }
+};
+
+#endif //RENDERENGINE_GEOMETRYREGISTRY_H
@@ -0,0 +1,274 @@
+/**
+ * @file LodSelector.h
+ * @brief File with the selection of the level of detail used to draw each model.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef RENDERENGINE_LODSELECTOR_H
+#define RENDERENGINE_LODSELECTOR_H
+
+#include <Model.h>
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * @brief Level of detail chosen for a model in a frame.
+ *
+ */
+struct LodSelection
+{
+    //! Level of detail to draw
+    unsigned int level = 0;
+
+    //! Level that is fading out (only used if fade is less than 1)
+    unsigned int previous = 0;
+
+    //! Fraction of the pixels drawn with level (1 when there is no transition)
+    float fade = 1.0f;
+};
+
+/**
+ * @brief Choose the level of detail of the models from their error in the screen.
+ *
+ * The error of each level (relative to the size of the model, see MeshLod) is projected to
+ * pixels with the distance to the camera, the field of view and the height of the screen,
+ * and the coarsest level whose error is under the threshold is used.
+ *
+ * To avoid the popping when a model is near the distance where the level changes, a coarser
+ * level is only taken when its error is under the threshold reduced by the hysteresis. The
+ * transitions can also be dithered during some frames (the fragment shaders must include
+ * Shaders/LodDither.glsl and call lodDither(), the bundled ones do it, in other case both
+ * levels are drawn completely).
+ */
+class LodSelector
+{
+private:
+    /**
+     * @brief State of the level of detail of a model between frames.
+     *
+     */
+    struct LodState
+    {
+        //! Level used in the last frame
+        unsigned int level = 0;
+
+        //! Level used before the last change
+        unsigned int previous = 0;
+
+        //! Frames left of the transition between previous and level
+        unsigned int transition = 0;
+    };
+
+    //! Maximum error (in pixels) allowed in the screen
+    float pixelError = 1.0f;
+
+    //! Global bias, each unit doubles the error allowed (negative values improve the quality)
+    float bias = 0.0f;
+
+    //! Fraction of the threshold that the error of a coarser level must be under to change to it
+    float hysteresis = 0.25f;
+
+    //! Dither the transitions between levels
+    bool dither = false;
+
+    //! Number of frames of the dithered transitions
+    unsigned int transitionFrames = 8;
+
+    //! State of each model (by position in the scene)
+    std::vector<LodState> states;
+
+public:
+    /**
+     * @brief Get the error in pixels of a level of detail of a model.
+     *
+     * @param m Model.
+     * @param level Level of detail.
+     * @param cameraPosition Position of the camera.
+     * @param fieldOfView Vertical field of view of the camera (radians).
+     * @param height Height of the screen in pixels.
+     * @return float Error of the level in pixels.
+     */
+    static float projectedError(Model *m, unsigned int level, const glm::vec3 &cameraPosition, float fieldOfView, int height)
+    {
+        glm::vec3 extent = m->getBoundsMax() - m->getBoundsMin();
+        float size = std::max(extent.x, std::max(extent.y, extent.z));
+
+        // distance to the bounding sphere of the model (0.1 is the near plane of the scene)
+        glm::vec3 center = glm::vec3(m->getModelMatrix() * glm::vec4((m->getBoundsMin() + m->getBoundsMax()) * 0.5f, 1.0f));
+        float distance = std::max(glm::length(center - cameraPosition) - glm::length(extent) * 0.5f, 0.1f);
+
+        float pixelsPerUnit = (float)height / (2.0f * std::tan(fieldOfView * 0.5f) * distance);
+        return m->getLod(level).error * size * pixelsPerUnit;
+    }
+
+    /**
+     * @brief Choose the level of detail of a model for the current frame.
+     *
+     * Must be called once per frame for each model.
+     *
+     * @param index Position of the model in the scene.
+     * @param m Model.
+     * @param cameraPosition Position of the camera.
+     * @param fieldOfView Vertical field of view of the camera (radians).
+     * @param height Height of the screen in pixels.
+     * @return LodSelection Level (or levels during a transition) to draw.
+     */
+    LodSelection select(size_t index, Model *m, const glm::vec3 &cameraPosition, float fieldOfView, int height)
+    {
+        if (index >= this->states.size())
+            this->states.resize(index + 1);
+
+        LodState &state = this->states[index];
+        unsigned int levels = (unsigned int)m->getLodCount();
+        state.level = std::min(state.level, levels - 1);
+        state.previous = std::min(state.previous, levels - 1);
+
+        if (levels > 1)
+        {
+            float threshold = this->pixelError * std::exp2(this->bias);
+            unsigned int finer = 0;
+            unsigned int coarser = 0;
+            for (unsigned int level = 1; level < levels; level++)
+            {
+                float error = projectedError(m, level, cameraPosition, fieldOfView, height);
+                if (error <= threshold)
+                    finer = level;
+                if (error <= threshold * (1.0f - this->hysteresis))
+                    coarser = level;
+            }
+
+            // more detail is taken immediately, less detail only with the margin of the hysteresis
+            unsigned int level = state.level;
+            if (finer < state.level)
+                level = finer;
+            else if (coarser > state.level)
+                level = coarser;
+
+            if (level != state.level)
+            {
+                state.previous = state.level;
+                state.level = level;
+                state.transition = this->dither ? this->transitionFrames : 0;
+            }
+        }
+
+        LodSelection selection;
+        selection.level = state.level;
+        selection.previous = state.previous;
+        if (state.transition > 0)
+        {
+            selection.fade = 1.0f - (float)state.transition / (float)(this->transitionFrames + 1);
+            state.transition--;
+        }
+
+        return selection;
+    }
+
+    /**
+     * @brief Forget the state of a model (when it is removed from the scene).
+     *
+     * @param index Position of the model in the scene.
+     */
+    void remove(size_t index)
+    {
+        if (index < this->states.size())
+            this->states.erase(this->states.begin() + index);
+    }
+
+    /**
+     * @brief Get the Pixel Error object
+     *
+     * @return float Maximum error (in pixels) allowed in the screen.
+     */
+    float getPixelError() const
+    {
+        return pixelError;
+    }
+
+    /**
+     * @brief Set the Pixel Error object
+     *
+     * @param pixels Maximum error (in pixels) allowed in the screen.
+     */
+    void setPixelError(float pixels)
+    {
+        this->pixelError = pixels;
+    }
+
+    /**
+     * @brief Get the Bias object
+     *
+     * @return float Global bias of the levels of detail.
+     */
+    float getBias() const
+    {
+        return bias;
+    }
+
+    /**
+     * @brief Set the Bias object
+     *
+     * Use positive values to draw coarser levels when the frame time is too high.
+     *
+     * @param lodBias Global bias, each unit doubles the error allowed.
+     */
+    void setBias(float lodBias)
+    {
+        this->bias = lodBias;
+    }
+
+    /**
+     * @brief Get the Hysteresis object
+     *
+     * @return float Margin used to change to a coarser level.
+     */
+    float getHysteresis() const
+    {
+        return hysteresis;
+    }
+
+    /**
+     * @brief Set the Hysteresis object
+     *
+     * @param margin Fraction of the threshold that the error of a coarser level must be under to change to it (0 to 1).
+     */
+    void setHysteresis(float margin)
+    {
+        this->hysteresis = margin;
+    }
+
+    /**
+     * @brief Get the Dither object
+     *
+     * @return true If the transitions are dithered.
+     */
+    bool getDither() const
+    {
+        return dither;
+    }
+
+    /**
+     * @brief Set the Dither object
+     *
+     * The transitions in progress are finished if the dithering is disabled, or shortened to
+     * the new number of frames.
+     *
+     * @param enabled If true the transitions are dithered (the shaders must call lodDither() of Shaders/LodDither.glsl).
+     * @param frames Number of frames of the transitions.
+     */
+    void setDither(bool enabled, unsigned int frames = 8)
+    {
+        this->dither = enabled;
+        this->transitionFrames = frames;
+        for (LodState &state : this->states)
+            state.transition = enabled ? std::min(state.transition, frames) : 0;
+    }
+};
+
+#endif //RENDERENGINE_LODSELECTOR_H
@@ -0,0 +1,201 @@
+/**
+ * @file MappedFile.h
+ * @brief File with the class used to read the content of the files loaded by the engine.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * The content of the file is memory-mapped when the platform allows it, in other case
+ * (or if the mapping fails) the file is read into a buffer with a single read.
+ */
+
+#ifndef RENDERENGINE_MAPPEDFILE_H
+#define RENDERENGINE_MAPPEDFILE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fstream>
+#include <cstddef>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RENDERENGINE_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/**
+ * @brief Read only view of the content of a file.
+ *
+ * Map the file in memory (with the sequential access hint, since the loaders read the
+ * files from the beginning to the end) or read it into a buffer. In both cases the content
+ * is accessed through data() and size() and it is valid while the object exists.
+ */
+class MappedFile
+{
+
+private:
+    //! Pointer to the content of the file
+    const char *content = nullptr;
+
+    //! Size of the content of the file
+    size_t length = 0;
+
+    //! True if the content is memory-mapped
+    bool mapped = false;
+
+    //! Buffer with the content when the file is not mapped
+    std::vector<char> buffer;
+
+public:
+    /**
+     * @brief Construct a new Mapped File object without content.
+     *
+     */
+    MappedFile() = default;
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /**
+     * @brief Destroy the Mapped File object, unmapping the file.
+     *
+     */
+    ~MappedFile()
+    {
+        close();
+    }
+
+    /**
+     * @brief Open a file and get its content.
+     *
+     * @param filename Name of the file.
+     * @param memoryMap If true try to memory-map the file, in other case it is read into a buffer.
+     * @return true If the file could be read.
+     */
+    bool open(const std::string &filename, bool memoryMap = true)
+    {
+        close();
+
+#ifdef RENDERENGINE_HAS_MMAP
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat info;
+        if (fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        length = (size_t)info.st_size;
+
+        // mmap of an empty file fails, there is nothing to read anyway
+        if (memoryMap && length > 0)
+        {
+            void *address = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED)
+            {
+                madvise(address, length, MADV_SEQUENTIAL);
+                content = (const char *)address;
+                mapped = true;
+            }
+        }
+
+        // fallback: read all the file
+        if (!mapped)
+        {
+#ifdef POSIX_FADV_SEQUENTIAL
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+            buffer.resize(length);
+            size_t offset = 0;
+            while (offset < length)
+            {
+                ssize_t count = ::read(fd, buffer.data() + offset, length - offset);
+                if (count <= 0)
+                    break;
+                offset += (size_t)count;
+            }
+            buffer.resize(offset);
+            content = buffer.data();
+            length = offset;
+        }
+
+        ::close(fd);
+        return true;
+#else
+        // platforms without mmap always read the file
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file)
+            return false;
+
+        buffer.resize((size_t)file.tellg());
+        file.seekg(0, std::ios::beg);
+        file.read(buffer.data(), (std::streamsize)buffer.size());
+        content = buffer.data();
+        length = (size_t)file.gcount();
+        return true;
+#endif
+    }
+
+    /**
+     * @brief Release the content of the file.
+     *
+     */
+    void close()
+    {
+#ifdef RENDERENGINE_HAS_MMAP
+        if (mapped)
+            munmap((void *)content, length);
+#endif
+        content = nullptr;
+        length = 0;
+        mapped = false;
+        buffer = std::vector<char>();
+    }
+
+    /**
+     * @brief Get the content of the file.
+     *
+     * @return const char* Pointer to the first byte of the file.
+     */
+    [[nodiscard]] const char *data() const
+    {
+        return content;
+    }
+
+    /**
+     * @brief Get the size of the file.
+     *
+     * @return size_t Number of bytes of the file.
+     */
+    [[nodiscard]] size_t size() const
+    {
+        return length;
+    }
+
+    /**
+     * @brief Get the content of the file as text.
+     *
+     * @return std::string_view Text of the file.
+     */
+    [[nodiscard]] std::string_view view() const
+    {
+        return std::string_view(content, length);
+    }
+
+    /**
+     * @brief Check if the content is memory-mapped.
+     *
+     * @return true If the file is memory-mapped, false if it was read into a buffer.
+     */
+    [[nodiscard]] bool isMapped() const
+    {
+        return mapped;
+    }
+};
+
+#endif //RENDERENGINE_MAPPEDFILE_H
@@ -0,0 +1,407 @@
+/**
+ * @file MeshCache.h
+ * @brief File with the binary cache (.rmesh files) of the geometry of the models.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * The first time that a model file is loaded its geometry (already triangulated and
+ * indexed) is written in a .rmesh file. The following runs map that file and give the
+ * pointers of the mapping directly to OpenGL, so the source file is not parsed again.
+ *
+ * Layout of a .rmesh file:
+ *      - MeshCacheHeader.
+ *      - Vertex data (vertexCount vertex of stride bytes, see VertexLayout).
+ *      - Index data (indexCount indexes of indexSize bytes).
+ *      - Meshlets (meshletCount Meshlet structs).
+ *      - Levels of detail (lodCount MeshLod structs, their indices are in the index data).
+ */
+
+#ifndef RENDERENGINE_MESHCACHE_H
+#define RENDERENGINE_MESHCACHE_H
+
+#include <MappedFile.h>
+#include <MeshOptimizer.h>
+#include <MeshSimplifier.h>
+#include <Utils.h>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+
+//! Version of the .rmesh format, files with other version are ignored
+const uint32_t MESH_CACHE_VERSION = 6;
+
+/**
+ * @brief Identify the source file used to generate a cache file.
+ *
+ */
+struct MeshCacheKey
+{
+    //! Hash of the path of the source file
+    uint64_t pathHash = 0;
+
+    //! Size of the source file in bytes
+    uint64_t sourceSize = 0;
+
+    //! Last modification time of the source file
+    int64_t sourceTime = 0;
+
+    //! Hash of the content of the source file
+    uint64_t sourceHash = 0;
+};
+
+/**
+ * @brief Header at the beginning of the .rmesh files.
+ *
+ */
+struct MeshCacheHeader
+{
+    //! Magic number of the format (RMSH)
+    char magic[4];
+
+    //! Version of the format
+    uint32_t version;
+
+    //! Source file used to generate the cache
+    MeshCacheKey key;
+
+    //! Number of bytes of each vertex
+    uint32_t stride;
+
+    //! Mask with the locations of the attributes of the vertex (see VertexLayout::mask)
+    uint32_t attributes;
+
+    //! Number of bytes of each index (2 or 4)
+    uint32_t indexSize;
+
+    //! Format of the attributes of the vertex (see VertexFormat)
+    uint32_t format;
+
+    //! Number of vertices
+    uint64_t vertexCount;
+
+    //! Number of indexes
+    uint64_t indexCount;
+
+    //! Offset in the file of the vertex data
+    uint64_t vertexOffset;
+
+    //! Offset in the file of the index data
+    uint64_t indexOffset;
+
+    //! Number of meshlets
+    uint64_t meshletCount;
+
+    //! Offset in the file of the meshlets
+    uint64_t meshletOffset;
+
+    //! Number of levels of detail
+    uint64_t lodCount;
+
+    //! Offset in the file of the levels of detail
+    uint64_t lodOffset;
+
+    //! Minimum corner of the bounding box of the vertices
+    float boundsMin[3];
+
+    //! Maximum corner of the bounding box of the vertices
+    float boundsMax[3];
+
+    //! Radius of the bounding sphere of the vertices (centered in the bounding box)
+    float boundsRadius;
+
+    //! Unused, keeps the size a multiple of 8 bytes
+    uint32_t reserved;
+
+    //! Hash of the options of the loader that change the geometry (the cache is only used with the same options)
+    uint64_t optionsHash;
+};
+
+static_assert(sizeof(MeshCacheHeader) == 160, "MeshCacheHeader must not have padding that changes between compilers");
+
+/**
+ * @brief Geometry stored in a cache file.
+ *
+ * The pointers are valid while the file exists (it can be shared by several objects).
+ */
+struct MeshCacheView
+{
+    //! File with the cache (memory-mapped when possible)
+    std::shared_ptr<MappedFile> file;
+
+    //! Header of the cache
+    const MeshCacheHeader *header = nullptr;
+
+    //! Pointer to the vertex data
+    const void *vertex = nullptr;
+
+    //! Pointer to the index data
+    const void *indices = nullptr;
+
+    //! Pointer to the meshlets
+    const Meshlet *meshlets = nullptr;
+
+    //! Pointer to the levels of detail
+    const MeshLod *lods = nullptr;
+};
+
+/**
+ * @brief Methods to read and write the .rmesh files.
+ *
+ */
+class MeshCache
+{
+public:
+    /**
+     * @brief Get the path of the cache file of a source file.
+     *
+     * @param source Path to the source file.
+     * @param directory Directory of the cache files, if empty the cache is stored next to the source.
+     * @return std::string Path to the cache file.
+     */
+    static std::string cachePath(const std::string &source, const std::string &directory)
+    {
+        if (directory.empty())
+            return source + ".rmesh";
+
+        // the name of the cache is the hash of the path so files with the same name do not collide
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.rmesh", (unsigned long long)hashBytes(source.data(), source.size()));
+        return directory + "/" + name;
+    }
+
+    /**
+     * @brief Get the key of a source file without reading its content.
+     *
+     * The sourceHash of the key is not calculated.
+     *
+     * @param source Path to the source file.
+     * @param key Key where the information is stored.
+     * @return true If the file exists.
+     */
+    static bool sourceKey(const std::string &source, MeshCacheKey &key)
+    {
+        struct stat info;
+        if (stat(source.c_str(), &info) != 0)
+            return false;
+
+        key.pathHash = hashBytes(source.data(), source.size());
+        key.sourceSize = (uint64_t)info.st_size;
+        key.sourceTime = (int64_t)info.st_mtime;
+        return true;
+    }
+
+    /**
+     * @brief Read a cache file.
+     *
+     * The cache is valid if it was generated from the same path, with the same size and the
+     * same modification time. If only the modification time is different the content of the
+     * source is hashed and compared with the hash stored in the cache, if it matches the new
+     * modification time is stored in the cache (see updateSourceTime).
+     *
+     * @param cacheFile Path to the cache file.
+     * @param source Path to the source file.
+     * @param view View where the geometry of the cache is stored.
+     * @param memoryMap If true the cache is memory-mapped.
+     * @return true If the cache exists and is valid.
+     */
+    static bool read(const std::string &cacheFile, const std::string &source, MeshCacheView &view, bool memoryMap = true)
+    {
+        MeshCacheKey key;
+        if (!sourceKey(source, key))
+            return false;
+
+        std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+        if (!file->open(cacheFile, memoryMap) || file->size() < sizeof(MeshCacheHeader))
+            return false;
+
+        const MeshCacheHeader *header = (const MeshCacheHeader *)file->data();
+        if (std::memcmp(header->magic, "RMSH", 4) != 0 || header->version != MESH_CACHE_VERSION ||
+            header->key.pathHash != key.pathHash || header->key.sourceSize != key.sourceSize)
+        {
+            return false;
+        }
+
+        // the file was touched, check if the content really changed
+        if (header->key.sourceTime != key.sourceTime)
+        {
+            MappedFile sourceFile;
+            if (!sourceFile.open(source, memoryMap) || hashBytes(sourceFile.data(), sourceFile.size()) != header->key.sourceHash)
+                return false;
+
+            // the next reads take the fast path again
+            updateSourceTime(cacheFile, key.sourceTime);
+        }
+
+        // the sizes must match with the file (truncated files)
+        if (header->vertexOffset + header->vertexCount * header->stride > file->size() ||
+            header->indexOffset + header->indexCount * header->indexSize > file->size() ||
+            header->meshletOffset + header->meshletCount * sizeof(Meshlet) > file->size() ||
+            header->lodOffset + header->lodCount * sizeof(MeshLod) > file->size())
+        {
+            return false;
+        }
+
+        view.file = file;
+        view.header = header;
+        view.vertex = file->data() + header->vertexOffset;
+        view.indices = file->data() + header->indexOffset;
+        view.meshlets = (const Meshlet *)(file->data() + header->meshletOffset);
+        view.lods = (const MeshLod *)(file->data() + header->lodOffset);
+        return true;
+    }
+
+    /**
+     * @brief Store a new modification time of the source in the header of a cache file.
+     *
+     * Only the field of the header is written, the file keeps its data. The cache is still
+     * valid if it cannot be written (it is hashed again in the next read).
+     *
+     * @param cacheFile Path to the cache file.
+     * @param sourceTime Modification time of the source file.
+     * @return true If the header was written.
+     */
+    static bool updateSourceTime(const std::string &cacheFile, int64_t sourceTime)
+    {
+        std::fstream file(cacheFile, std::ios::binary | std::ios::in | std::ios::out);
+        if (!file)
+            return false;
+
+        file.seekp((std::streamoff)(offsetof(MeshCacheHeader, key) + offsetof(MeshCacheKey, sourceTime)));
+        file.write((const char *)&sourceTime, sizeof(sourceTime));
+        return (bool)file;
+    }
+
+    /**
+     * @brief Write a cache file.
+     *
+     * The file is written with a temporary name (unique for each process and thread) and
+     * renamed at the end, so a process reading the cache never sees a file half written. If
+     * other writer already stored the cache of the same source and options it is kept, so
+     * the loads of the same file at the same time do not remove the cache of each other.
+     *
+     * @param cacheFile Path to the cache file.
+     * @param header Header of the cache (the magic, version and offsets are filled by the method).
+     * @param vertex Vertex data.
+     * @param indices Index data.
+     * @param meshlets Meshlets of the geometry (meshletCount of the header).
+     * @param lods Levels of detail of the geometry (lodCount of the header).
+     * @return true If the file was written.
+     */
+    static bool write(const std::string &cacheFile, MeshCacheHeader header, const void *vertex, const void *indices,
+                      const Meshlet *meshlets, const MeshLod *lods)
+    {
+        std::memcpy(header.magic, "RMSH", 4);
+        header.version = MESH_CACHE_VERSION;
+
+        // the data is aligned to 16 bytes
+        size_t vertexSize = header.vertexCount * header.stride;
+        header.vertexOffset = align(sizeof(MeshCacheHeader));
+        header.indexOffset = align(header.vertexOffset + vertexSize);
+        size_t indexSize = header.indexCount * header.indexSize;
+        header.meshletOffset = align(header.indexOffset + indexSize);
+        size_t meshletSize = header.meshletCount * sizeof(Meshlet);
+        header.lodOffset = align(header.meshletOffset + meshletSize);
+
+        std::string temporary = temporaryPath(cacheFile);
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file)
+                return false;
+
+            const char padding[16] = {};
+            file.write((const char *)&header, sizeof(header));
+            file.write(padding, (std::streamsize)(header.vertexOffset - sizeof(header)));
+            file.write((const char *)vertex, (std::streamsize)vertexSize);
+            file.write(padding, (std::streamsize)(header.indexOffset - header.vertexOffset - vertexSize));
+            file.write((const char *)indices, (std::streamsize)indexSize);
+            file.write(padding, (std::streamsize)(header.meshletOffset - header.indexOffset - indexSize));
+            file.write((const char *)meshlets, (std::streamsize)meshletSize);
+            file.write(padding, (std::streamsize)(header.lodOffset - header.meshletOffset - meshletSize));
+            file.write((const char *)lods, (std::streamsize)(header.lodCount * sizeof(MeshLod)));
+
+            if (!file)
+            {
+                file.close();
+                std::remove(temporary.c_str());
+                return false;
+            }
+        }
+
+        if (sameCache(cacheFile, header))
+        {
+            std::remove(temporary.c_str());
+            return true;
+        }
+
+        // rename does not replace existing files in windows
+        std::remove(cacheFile.c_str());
+        if (std::rename(temporary.c_str(), cacheFile.c_str()) == 0)
+            return true;
+
+        // other writer renamed its file between the remove and the rename
+        std::remove(temporary.c_str());
+        return sameCache(cacheFile, header);
+    }
+
+private:
+    /**
+     * @brief Get a temporary path for a cache file, unique for each process, thread and write.
+     *
+     * @param cacheFile Path to the cache file.
+     * @return std::string Path of the temporary file.
+     */
+    static std::string temporaryPath(const std::string &cacheFile)
+    {
+        static std::atomic<unsigned int> writes(0);
+        unsigned long long process = 0;
+#ifdef RENDERENGINE_HAS_MMAP
+        process = (unsigned long long)getpid();
+#endif
+        char suffix[64];
+        std::snprintf(suffix, sizeof(suffix), ".%llu.%zx.%u.tmp", process, std::hash<std::thread::id>()(std::this_thread::get_id()),
+                      writes++);
+        return cacheFile + suffix;
+    }
+
+    /**
+     * @brief Check if a cache file was generated from the same source with the same options.
+     *
+     * @param cacheFile Path to the cache file.
+     * @param header Header of the cache that is being written.
+     * @return true If the file exists and has the key and the options of the header.
+     */
+    static bool sameCache(const std::string &cacheFile, const MeshCacheHeader &header)
+    {
+        MeshCacheHeader existing;
+        std::ifstream file(cacheFile, std::ios::binary);
+        if (!file || !file.read((char *)&existing, sizeof(existing)))
+            return false;
+
+        return std::memcmp(existing.magic, "RMSH", 4) == 0 && existing.version == MESH_CACHE_VERSION &&
+               existing.key.pathHash == header.key.pathHash && existing.key.sourceSize == header.key.sourceSize &&
+               existing.key.sourceHash == header.key.sourceHash && existing.optionsHash == header.optionsHash;
+    }
+
+    /**
+     * @brief Align an offset to 16 bytes.
+     *
+     * @param offset Offset to align.
+     * @return uint64_t Aligned offset.
+     */
+    static uint64_t align(uint64_t offset)
+    {
+        return (offset + 15) & ~(uint64_t)15;
+    }
+};
+
+#endif //RENDERENGINE_MESHCACHE_H
@@ -0,0 +1,775 @@
+/**
+ * @file MeshOptimizer.h
+ * @brief File with the algorithms used to prepare the geometry of the models for the GPU.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef RENDERENGINE_MESHOPTIMIZER_H
+#define RENDERENGINE_MESHOPTIMIZER_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+//! Number of entries of the post-transform vertex cache simulated by the optimizations
+const unsigned int VERTEX_CACHE_SIZE = 16;
+
+/**
+ * @brief Efficiency of an index buffer with the post-transform vertex cache.
+ *
+ */
+struct VertexCacheStatistics
+{
+    //! Number of vertex transformed (cache misses)
+    size_t misses = 0;
+
+    //! Average cache miss ratio: vertex transformed per triangle (0.5 is the best possible, 3 the worst)
+    float acmr = 0.0f;
+
+    //! Average transform to vertex ratio: vertex transformed per vertex of the mesh (1 is the best possible)
+    float atvr = 0.0f;
+};
+
+/**
+ * @brief Cluster of triangles that is culled as a unit.
+ *
+ * The triangles of a meshlet are consecutive in the index buffer of the model.
+ */
+struct Meshlet
+{
+    //! Position in the index buffer of the first index of the meshlet
+    uint32_t indexOffset;
+
+    //! Number of triangles of the meshlet
+    uint32_t triangleCount;
+
+    //! Number of different vertices used by the triangles
+    uint32_t vertexCount;
+
+    //! Center of the bounding sphere of the meshlet
+    float center[3];
+
+    //! Radius of the bounding sphere of the meshlet
+    float radius;
+
+    //! Average direction of the normals of the triangles
+    float coneAxis[3];
+
+    //! Sine of the angle between the axis and the normal that deviates most (1 if the meshlet can not be back-face culled)
+    float coneCutoff;
+};
+
+//! Maximum number of vertices of a meshlet
+const unsigned int MESHLET_MAX_VERTICES = 64;
+
+//! Maximum number of triangles of a meshlet
+const unsigned int MESHLET_MAX_TRIANGLES = 124;
+
+/**
+ * @brief Collection of algorithms that work over the geometry of the models.
+ *
+ * The vertices are arrays of floats where each vertex uses the same number of floats (the
+ * stride) and the triangles are index buffers with three indexes per triangle.
+ */
+class MeshOptimizer
+{
+public:
+    /**
+     * @brief Build an index buffer with the unique vertices of a list of triangle corners.
+     *
+     * Each corner is converted to a vertex using the fetch function and the corners whose
+     * vertex is exactly equal (all its floats) share the same index.
+     *
+     * The fetch function must follow the contract: void fetch(size_t corner, float *vertex),
+     * writing stride floats in vertex.
+     *
+     * @param cornerCount Number of corners (three per triangle).
+     * @param stride Number of floats of each vertex.
+     * @param fetch Function that writes the vertex of a corner.
+     * @param vertices Vector where the unique vertices are stored.
+     * @param indices Vector where the index of the vertex of each corner is stored.
+     */
+    template <class Fetch>
+    static void indexVertices(size_t cornerCount, size_t stride, Fetch fetch, std::vector<float> &vertices,
+                              std::vector<unsigned int> &indices)
+    {
+        vertices.clear();
+        indices.resize(cornerCount);
+
+        // open addressing hash table with the indexes of the unique vertices
+        size_t capacity = 1;
+        while (capacity < cornerCount + cornerCount / 4)
+            capacity *= 2;
+        std::vector<unsigned int> table(capacity, EMPTY);
+
+        std::vector<float> vertex(stride);
+        unsigned int uniqueCount = 0;
+        for (size_t corner = 0; corner < cornerCount; corner++)
+        {
+            fetch(corner, vertex.data());
+
+            size_t slot = hash(vertex.data(), stride) & (capacity - 1);
+            while (table[slot] != EMPTY &&
+                   std::memcmp(&vertices[(size_t)table[slot] * stride], vertex.data(), stride * sizeof(float)) != 0)
+            {
+                slot = (slot + 1) & (capacity - 1);
+            }
+
+            // new vertex
+            if (table[slot] == EMPTY)
+            {
+                table[slot] = uniqueCount++;
+                vertices.insert(vertices.end(), vertex.begin(), vertex.end());
+            }
+
+            indices[corner] = table[slot];
+        }
+    }
+
+    /**
+     * @brief Simulate a FIFO post-transform vertex cache over an index buffer.
+     *
+     * @param indices Index buffer (three indexes per triangle).
+     * @param vertexCount Number of vertices referenced by the index buffer.
+     * @param cacheSize Number of entries of the cache.
+     * @return VertexCacheStatistics Misses of the index buffer.
+     */
+    static VertexCacheStatistics analyzeVertexCache(const std::vector<unsigned int> &indices, size_t vertexCount,
+                                                    unsigned int cacheSize = VERTEX_CACHE_SIZE)
+    {
+        VertexCacheStatistics statistics;
+
+        // a vertex is in the FIFO if it entered less than cacheSize misses ago
+        std::vector<size_t> entered(vertexCount, 0);
+        size_t time = cacheSize + 1;
+        for (unsigned int index : indices)
+        {
+            if (time - entered[index] > cacheSize)
+            {
+                entered[index] = time++;
+                statistics.misses++;
+            }
+        }
+
+        size_t triangleCount = indices.size() / 3;
+        statistics.acmr = triangleCount > 0 ? (float)statistics.misses / (float)triangleCount : 0.0f;
+        statistics.atvr = vertexCount > 0 ? (float)statistics.misses / (float)vertexCount : 0.0f;
+        return statistics;
+    }
+
+    /**
+     * @brief Reorder the triangles to reuse the vertices of the post-transform cache (Tipsify).
+     *
+     * Implementation of the algorithm of Sander, Nehab and Barczak, "Fast Triangle Reordering
+     * for Vertex Locality and Reduced Overdraw". The triangles are emitted fanning around a
+     * vertex and the next vertex is chosen between the ones that are still in the cache.
+     *
+     * The positions where the algorithm had to jump to a vertex outside the cache are stored in
+     * clusters (index of the first triangle of each cluster), they are used by optimizeOverdraw.
+     *
+     * @param indices Index buffer to reorder (three indexes per triangle).
+     * @param vertexCount Number of vertices referenced by the index buffer.
+     * @param clusters Vector where the first triangle of each cluster is stored (can be nullptr).
+     * @param cacheSize Number of entries of the cache.
+     */
+    static void optimizeVertexCache(std::vector<unsigned int> &indices, size_t vertexCount, std::vector<unsigned int> *clusters = nullptr,
+                                    unsigned int cacheSize = VERTEX_CACHE_SIZE)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (clusters != nullptr)
+            clusters->clear();
+        if (triangleCount == 0)
+            return;
+
+        // triangles that use each vertex (compressed in a single array)
+        std::vector<unsigned int> liveTriangles(vertexCount, 0);
+        for (unsigned int index : indices)
+            liveTriangles[index]++;
+
+        std::vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + liveTriangles[v];
+
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[filled[indices[i]]++] = (unsigned int)(i / 3);
+
+        std::vector<size_t> entered(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnd;
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+
+        size_t time = cacheSize + 1;
+        size_t cursor = 0;
+        long fanning = 0;
+        while (fanning >= 0)
+        {
+            // emit all the triangles around the vertex
+            candidates.clear();
+            for (unsigned int i = offsets[fanning]; i < offsets[fanning + 1]; i++)
+            {
+                unsigned int triangle = adjacency[i];
+                if (emitted[triangle])
+                    continue;
+
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    unsigned int v = indices[3 * triangle + corner];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    liveTriangles[v]--;
+                    if (time - entered[v] > cacheSize)
+                        entered[v] = time++;
+                }
+                emitted[triangle] = true;
+            }
+
+            // next vertex: the one that stays in the cache after emitting all its triangles
+            long next = -1;
+            size_t bestPriority = 0;
+            for (unsigned int v : candidates)
+            {
+                if (liveTriangles[v] == 0)
+                    continue;
+
+                size_t priority = 0;
+                if (time - entered[v] + 2 * liveTriangles[v] <= cacheSize)
+                    priority = time - entered[v];
+
+                if (next < 0 || priority > bestPriority)
+                {
+                    next = v;
+                    bestPriority = priority;
+                }
+            }
+
+            // dead end, take a recently used vertex or the next vertex of the mesh
+            if (next < 0)
+            {
+                while (!deadEnd.empty() && next < 0)
+                {
+                    unsigned int v = deadEnd.back();
+                    deadEnd.pop_back();
+                    if (liveTriangles[v] > 0)
+                        next = v;
+                }
+
+                while (next < 0 && cursor < vertexCount)
+                {
+                    if (liveTriangles[cursor] > 0)
+                        next = (long)cursor;
+                    cursor++;
+                }
+
+                if (next >= 0 && clusters != nullptr && time - entered[next] > cacheSize)
+                    clusters->push_back((unsigned int)(result.size() / 3));
+            }
+
+            fanning = next;
+        }
+
+        if (clusters != nullptr && (clusters->empty() || clusters->front() != 0))
+            clusters->insert(clusters->begin(), 0);
+
+        indices = std::move(result);
+    }
+
+    /**
+     * @brief Reorder the clusters of triangles to draw first the ones that occlude the rest.
+     *
+     * The clusters of optimizeVertexCache are split again in the points where the cache
+     * efficiency is still inside the threshold, then they are sorted so the clusters that
+     * face away from the center of the mesh (usually in front of the rest) are drawn first,
+     * which reduces the overdraw when the depth test is enabled.
+     *
+     * @param indices Index buffer already optimized for the vertex cache.
+     * @param vertices Vertices of the mesh (the position must be the first 3 floats of each vertex).
+     * @param stride Number of floats of each vertex.
+     * @param clusters First triangle of each cluster (output of optimizeVertexCache).
+     * @param threshold Maximum ACMR degradation allowed (1.05 allows a 5% worse ACMR).
+     * @param cacheSize Number of entries of the cache.
+     */
+    static void optimizeOverdraw(std::vector<unsigned int> &indices, const std::vector<float> &vertices, size_t stride,
+                                 const std::vector<unsigned int> &clusters, float threshold = 1.05f,
+                                 unsigned int cacheSize = VERTEX_CACHE_SIZE)
+    {
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0 || clusters.empty())
+            return;
+
+        // split the clusters where the ACMR of the part is already as good as the one of the whole cluster
+        std::vector<unsigned int> splits;
+        std::vector<size_t> entered(vertices.size() / stride, 0);
+        size_t time = cacheSize + 1;
+        for (size_t c = 0; c < clusters.size(); c++)
+        {
+            size_t start = clusters[c];
+            size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+            time += cacheSize + 1;
+            size_t clusterMisses = 0;
+            for (size_t i = 3 * start; i < 3 * end; i++)
+            {
+                if (time - entered[indices[i]] > cacheSize)
+                {
+                    entered[indices[i]] = time++;
+                    clusterMisses++;
+                }
+            }
+            float clusterAcmr = (float)clusterMisses / (float)(end - start);
+
+            time += cacheSize + 1;
+            splits.push_back((unsigned int)start);
+            size_t partStart = start;
+            size_t partMisses = 0;
+            for (size_t t = start; t < end; t++)
+            {
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    unsigned int v = indices[3 * t + corner];
+                    if (time - entered[v] > cacheSize)
+                    {
+                        entered[v] = time++;
+                        partMisses++;
+                    }
+                }
+
+                float partAcmr = (float)partMisses / (float)(t + 1 - partStart);
+                if (t + 1 < end && partAcmr <= clusterAcmr * threshold)
+                {
+                    splits.push_back((unsigned int)(t + 1));
+                    partStart = t + 1;
+                    partMisses = 0;
+                    time += cacheSize + 1;
+                }
+            }
+        }
+
+        // centroid and normal of each cluster weighted by the area of the triangles
+        size_t clusterCount = splits.size();
+        std::vector<float> centroids(3 * clusterCount, 0.0f);
+        std::vector<float> normals(3 * clusterCount, 0.0f);
+        std::vector<float> areas(clusterCount, 0.0f);
+        float meshCentroid[3] = {0.0f, 0.0f, 0.0f};
+        float meshArea = 0.0f;
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            size_t end = c + 1 < clusterCount ? splits[c + 1] : triangleCount;
+            for (size_t t = splits[c]; t < end; t++)
+            {
+                const float *p0 = &vertices[stride * indices[3 * t]];
+                const float *p1 = &vertices[stride * indices[3 * t + 1]];
+                const float *p2 = &vertices[stride * indices[3 * t + 2]];
+
+                float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+                float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+                float normal[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+                float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+                for (int i = 0; i < 3; i++)
+                {
+                    float center = (p0[i] + p1[i] + p2[i]) / 3.0f;
+                    centroids[3 * c + i] += center * area;
+                    normals[3 * c + i] += normal[i];
+                    meshCentroid[i] += center * area;
+                }
+                areas[c] += area;
+                meshArea += area;
+            }
+        }
+
+        for (int i = 0; i < 3; i++)
+            meshCentroid[i] = meshArea > 0.0f ? meshCentroid[i] / meshArea : 0.0f;
+
+        std::vector<float> keys(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+        {
+            float *normal = &normals[3 * c];
+            float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+            float key = 0.0f;
+            for (int i = 0; i < 3; i++)
+            {
+                float centroid = areas[c] > 0.0f ? centroids[3 * c + i] / areas[c] : 0.0f;
+                key += (centroid - meshCentroid[i]) * (length > 0.0f ? normal[i] / length : 0.0f);
+            }
+            keys[c] = key;
+        }
+
+        std::vector<unsigned int> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; c++)
+            order[c] = (unsigned int)c;
+        std::stable_sort(order.begin(), order.end(), [&keys](unsigned int a, unsigned int b) { return keys[a] > keys[b]; });
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (unsigned int c : order)
+        {
+            size_t end = c + 1 < clusterCount ? splits[c + 1] : triangleCount;
+            result.insert(result.end(), indices.begin() + 3 * splits[c], indices.begin() + 3 * end);
+        }
+
+        indices = std::move(result);
+    }
+
+    /**
+     * @brief Reorder the vertices in the order that they are used by the index buffer.
+     *
+     * The GPU reads the vertex buffer sequentially, so the vertices used by consecutive
+     * triangles end in the same cache lines. Vertices that are not used are removed.
+     *
+     * @param vertices Vertices to reorder.
+     * @param stride Number of floats of each vertex.
+     * @param indices Index buffer, it is updated with the new positions of the vertices.
+     * @return size_t Number of vertices after the reorder.
+     */
+    static size_t optimizeVertexFetch(std::vector<float> &vertices, size_t stride, std::vector<unsigned int> &indices)
+    {
+        std::vector<unsigned int> remap(vertices.size() / stride, EMPTY);
+        std::vector<float> result;
+        result.reserve(vertices.size());
+
+        unsigned int vertexCount = 0;
+        for (unsigned int &index : indices)
+        {
+            if (remap[index] == EMPTY)
+            {
+                remap[index] = vertexCount++;
+                result.insert(result.end(), vertices.begin() + stride * index, vertices.begin() + stride * (index + 1));
+            }
+            index = remap[index];
+        }
+
+        vertices = std::move(result);
+        return vertexCount;
+    }
+
+    /**
+     * @brief Split the triangles of a mesh in meshlets.
+     *
+     * Each meshlet grows from a seed triangle adding the neighbour triangle that uses less new
+     * vertices and whose normal is nearer to the average normal of the meshlet, so the meshlets
+     * are compact (small bounding spheres) and flat (narrow normal cones, that can be
+     * back-face culled). The seeds are taken in the order of the index buffer, so the order of
+     * the previous optimizations is roughly kept. The index buffer is reordered to have the
+     * triangles of each meshlet together.
+     *
+     * The bounding sphere and the normal cone of each meshlet are calculated for the culling,
+     * a meshlet is back-facing from a point p if dot(center - p, coneAxis) >= coneCutoff *
+     * length(center - p) + radius.
+     *
+     * @param indices Index buffer (three indexes per triangle), it is reordered.
+     * @param vertices Vertices of the mesh (the position must be the first 3 floats of each vertex).
+     * @param stride Number of floats of each vertex.
+     * @param meshlets Vector where the meshlets are stored.
+     * @param maxVertices Maximum number of vertices of each meshlet.
+     * @param maxTriangles Maximum number of triangles of each meshlet.
+     */
+    static void buildMeshlets(std::vector<unsigned int> &indices, const std::vector<float> &vertices, size_t stride,
+                              std::vector<Meshlet> &meshlets, unsigned int maxVertices = MESHLET_MAX_VERTICES,
+                              unsigned int maxTriangles = MESHLET_MAX_TRIANGLES)
+    {
+        meshlets.clear();
+        size_t triangleCount = indices.size() / 3;
+        size_t vertexCount = vertices.size() / stride;
+        if (triangleCount == 0)
+            return;
+
+        // the neighbours are found by position, the vertices split by the seams of the normals or the
+        // texture coordinates are still neighbours
+        std::vector<float> positions;
+        std::vector<unsigned int> positionIndex;
+        indexVertices(
+            vertexCount, 3, [&vertices, stride](size_t v, float *position) { std::memcpy(position, &vertices[stride * v], 3 * sizeof(float)); },
+            positions, positionIndex);
+        size_t positionCount = positions.size() / 3;
+
+        // triangles that use each position (compressed in a single array)
+        std::vector<unsigned int> offsets(positionCount + 1, 0);
+        for (unsigned int index : indices)
+            offsets[positionIndex[index] + 1]++;
+        for (size_t p = 0; p < positionCount; p++)
+            offsets[p + 1] += offsets[p];
+
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[filled[positionIndex[indices[i]]]++] = (unsigned int)(i / 3);
+
+        // unit normal of each triangle (0 for the degenerated ones)
+        std::vector<float> normals(3 * triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleNormal(indices, vertices, stride, t, &normals[3 * t]);
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> used(vertexCount, 0); // meshlet (plus one) that uses each vertex
+        std::vector<unsigned int> meshletVertices;
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+
+        size_t seed = 0;
+        while (result.size() < indices.size())
+        {
+            while (emitted[seed])
+                seed++;
+
+            unsigned int id = (unsigned int)meshlets.size() + 1;
+            size_t start = result.size() / 3;
+            meshletVertices.clear();
+            float axis[3] = {0.0f, 0.0f, 0.0f};
+
+            long triangle = (long)seed;
+            while (triangle >= 0)
+            {
+                // add the triangle to the meshlet
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    unsigned int v = indices[3 * triangle + corner];
+                    result.push_back(v);
+                    if (used[v] != id)
+                    {
+                        used[v] = id;
+                        meshletVertices.push_back(v);
+                    }
+                }
+                for (int i = 0; i < 3; i++)
+                    axis[i] += normals[3 * triangle + i];
+                emitted[triangle] = true;
+
+                if (result.size() / 3 - start >= maxTriangles)
+                    break;
+
+                float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+                float direction[3] = {0.0f, 0.0f, 0.0f};
+                for (int i = 0; i < 3 && length > 0.0f; i++)
+                    direction[i] = axis[i] / length;
+
+                // best neighbour: less new vertices, then nearer to the normal of the meshlet
+                triangle = -1;
+                float bestScore = 0.0f;
+                for (unsigned int v : meshletVertices)
+                {
+                    unsigned int position = positionIndex[v];
+                    for (unsigned int i = offsets[position]; i < offsets[position + 1]; i++)
+                    {
+                        unsigned int candidate = adjacency[i];
+                        if (emitted[candidate])
+                            continue;
+
+                        unsigned int newVertices = 0;
+                        for (int corner = 0; corner < 3; corner++)
+                            newVertices += used[indices[3 * candidate + corner]] != id;
+                        if (meshletVertices.size() + newVertices > maxVertices)
+                            continue;
+
+                        const float *normal = &normals[3 * candidate];
+                        float dot = normal[0] * direction[0] + normal[1] * direction[1] + normal[2] * direction[2];
+                        float score = (float)newVertices + (1.0f - dot);
+                        if (triangle < 0 || score < bestScore)
+                        {
+                            triangle = candidate;
+                            bestScore = score;
+                        }
+                    }
+                }
+
+                // without neighbours (borders of the mesh or seams of the attributes) continue with the next
+                // triangle of the index buffer, that is usually near after the vertex cache optimization
+                if (triangle < 0)
+                {
+                    while (seed < triangleCount && emitted[seed])
+                        seed++;
+                    if (seed < triangleCount && meshletVertices.size() + 3 <= maxVertices)
+                        triangle = (long)seed;
+                }
+            }
+
+            meshlets.push_back(meshletBounds(result, vertices, stride, start, result.size() / 3, (unsigned int)meshletVertices.size()));
+        }
+
+        // the growth of the meshlets does not follow the vertex cache, optimize each meshlet again
+        std::vector<unsigned int> local;
+        std::vector<unsigned int> global;
+        std::vector<unsigned int> remap(vertexCount, EMPTY);
+        for (const Meshlet &meshlet : meshlets)
+        {
+            local.clear();
+            global.clear();
+            for (size_t i = meshlet.indexOffset; i < meshlet.indexOffset + 3 * meshlet.triangleCount; i++)
+            {
+                unsigned int v = result[i];
+                if (remap[v] == EMPTY)
+                {
+                    remap[v] = (unsigned int)global.size();
+                    global.push_back(v);
+                }
+                local.push_back(remap[v]);
+            }
+
+            optimizeVertexCache(local, global.size());
+            for (size_t i = 0; i < local.size(); i++)
+                result[meshlet.indexOffset + i] = global[local[i]];
+            for (unsigned int v : global)
+                remap[v] = EMPTY;
+        }
+
+        indices = std::move(result);
+    }
+
+private:
+    /**
+     * @brief Calculate the bounding sphere and the normal cone of a range of triangles.
+     *
+     * @param indices Index buffer.
+     * @param vertices Vertices of the mesh.
+     * @param stride Number of floats of each vertex.
+     * @param start First triangle of the meshlet.
+     * @param end Triangle after the last one of the meshlet.
+     * @param vertexCount Number of different vertices of the meshlet.
+     * @return Meshlet Meshlet of the triangles.
+     */
+    static Meshlet meshletBounds(const std::vector<unsigned int> &indices, const std::vector<float> &vertices, size_t stride,
+                                 size_t start, size_t end, unsigned int vertexCount)
+    {
+        Meshlet meshlet = Meshlet();
+        meshlet.indexOffset = (uint32_t)(3 * start);
+        meshlet.triangleCount = (uint32_t)(end - start);
+        meshlet.vertexCount = vertexCount;
+
+        // center of the bounding box of the vertices
+        float minimum[3], maximum[3];
+        for (int i = 0; i < 3; i++)
+            minimum[i] = maximum[i] = vertices[stride * indices[3 * start] + i];
+
+        for (size_t c = 3 * start; c < 3 * end; c++)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                minimum[i] = std::min(minimum[i], vertices[stride * indices[c] + i]);
+                maximum[i] = std::max(maximum[i], vertices[stride * indices[c] + i]);
+            }
+        }
+
+        for (int i = 0; i < 3; i++)
+            meshlet.center[i] = (minimum[i] + maximum[i]) * 0.5f;
+
+        float radius = 0.0f;
+        for (size_t c = 3 * start; c < 3 * end; c++)
+        {
+            const float *p = &vertices[stride * indices[c]];
+            float distance = 0.0f;
+            for (int i = 0; i < 3; i++)
+                distance += (p[i] - meshlet.center[i]) * (p[i] - meshlet.center[i]);
+            radius = std::max(radius, distance);
+        }
+        meshlet.radius = std::sqrt(radius);
+
+        // normal cone: average of the normals and the normal that deviates most of it
+        std::vector<float> normals;
+        normals.reserve(3 * (end - start));
+        float axis[3] = {0.0f, 0.0f, 0.0f};
+        for (size_t t = start; t < end; t++)
+        {
+            float normal[3];
+            if (!triangleNormal(indices, vertices, stride, t, normal))
+                continue;
+
+            for (int i = 0; i < 3; i++)
+            {
+                normals.push_back(normal[i]);
+                axis[i] += normal[i];
+            }
+        }
+
+        float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+        meshlet.coneCutoff = 1.0f;
+        if (axisLength > 0.0f)
+        {
+            float minimumDot = 1.0f;
+            for (int i = 0; i < 3; i++)
+                meshlet.coneAxis[i] = axis[i] / axisLength;
+            for (size_t n = 0; n < normals.size(); n += 3)
+            {
+                float dot = normals[n] * meshlet.coneAxis[0] + normals[n + 1] * meshlet.coneAxis[1] + normals[n + 2] * meshlet.coneAxis[2];
+                minimumDot = std::min(minimumDot, dot);
+            }
+
+            // cones wider than ~84 degrees are almost never back-facing, they are not culled
+            if (minimumDot > 0.1f)
+                meshlet.coneCutoff = std::sqrt(1.0f - minimumDot * minimumDot);
+        }
+
+        return meshlet;
+    }
+
+    /**
+     * @brief Calculate the unit normal of a triangle.
+     *
+     * @param indices Index buffer.
+     * @param vertices Vertices of the mesh (the position must be the first 3 floats of each vertex).
+     * @param stride Number of floats of each vertex.
+     * @param triangle Triangle of the index buffer.
+     * @param normal Normal of the triangle (0 if the triangle is degenerated).
+     * @return true If the triangle is not degenerated.
+     */
+    static bool triangleNormal(const std::vector<unsigned int> &indices, const std::vector<float> &vertices, size_t stride,
+                               size_t triangle, float normal[3])
+    {
+        const float *p0 = &vertices[stride * indices[3 * triangle]];
+        const float *p1 = &vertices[stride * indices[3 * triangle + 1]];
+        const float *p2 = &vertices[stride * indices[3 * triangle + 2]];
+
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (int i = 0; i < 3; i++)
+            normal[i] = length > 0.0f ? normal[i] / length : 0.0f;
+
+        return length > 0.0f;
+    }
+
+    //! Value of the empty slots in the hash tables
+    static constexpr unsigned int EMPTY = ~0u;
+
+    /**
+     * @brief Hash of the bits of a vertex (murmur like mixing).
+     *
+     * @param vertex Floats of the vertex.
+     * @param stride Number of floats of the vertex.
+     * @return size_t Hash of the vertex.
+     */
+    static size_t hash(const float *vertex, size_t stride)
+    {
+        uint32_t h = 0x9747b28cu;
+        for (size_t i = 0; i < stride; i++)
+        {
+            uint32_t k;
+            std::memcpy(&k, &vertex[i], sizeof(k));
+
+            k *= 0x5bd1e995u;
+            k ^= k >> 24;
+            k *= 0x5bd1e995u;
+            h = (h * 0x5bd1e995u) ^ k;
+        }
+
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return h;
+    }
+};
+
+#endif //RENDERENGINE_MESHOPTIMIZER_H
@@ -0,0 +1,505 @@
+/**
+ * @file MeshSimplifier.h
+ * @brief File with the simplification of meshes used to generate the levels of detail.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef RENDERENGINE_MESHSIMPLIFIER_H
+#define RENDERENGINE_MESHSIMPLIFIER_H
+
+#include <MeshOptimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Level of detail of a mesh.
+ *
+ * All the levels use the vertex buffer of the model, each one is a range of its index buffer.
+ */
+struct MeshLod
+{
+    //! Position in the index buffer of the first index of the level
+    uint32_t indexOffset;
+
+    //! Number of indices of the level
+    uint32_t indexCount;
+
+    //! Maximum distance between the level and the original mesh, relative to the size of the mesh
+    float error;
+};
+
+/**
+ * @brief Simplification of triangle meshes with quadric error metrics (Garland and Heckbert).
+ *
+ * The edges are collapsed to one of their vertices (no new vertices are created, so all the
+ * levels share the vertex buffer) in order of the error that they introduce. The error of a
+ * collapse is the quadric error of the position plus the difference of the other attributes
+ * (normals, texture coordinates...) of the vertices that are merged, so the seams of the
+ * attributes are kept when possible. The vertices of the borders of the mesh never move.
+ */
+class MeshSimplifier
+{
+public:
+    /**
+     * @brief Simplify a mesh.
+     *
+     * @param indices Index buffer of the mesh (three indexes per triangle).
+     * @param vertices Vertices of the mesh (the position must be the first 3 floats of each vertex).
+     * @param stride Number of floats of each vertex.
+     * @param targetIndexCount Number of indices wanted (the result can have more if the error limit is reached).
+     * @param targetError Maximum error allowed, relative to the size of the mesh (0.01 is 1% of the size).
+     * @param result Index buffer of the simplified mesh.
+     * @param attributeWeight Weight of the difference of the attributes that are not the position (only changes the order of the collapses).
+     * @return float Geometric error of the simplified mesh, relative to the size of the mesh.
+     */
+    static float simplify(const std::vector<unsigned int> &indices, const std::vector<float> &vertices, size_t stride,
+                          size_t targetIndexCount, float targetError, std::vector<unsigned int> &result, float attributeWeight = 0.01f)
+    {
+        result = indices;
+        size_t vertexCount = vertices.size() / stride;
+        if (indices.empty() || vertexCount == 0)
+            return 0.0f;
+
+        // the collapses are done between positions, the vertices split by seams move together
+        std::vector<float> positions;
+        std::vector<unsigned int> positionIndex;
+        MeshOptimizer::indexVertices(
+            vertexCount, 3, [&vertices, stride](size_t v, float *position) { std::memcpy(position, &vertices[stride * v], 3 * sizeof(float)); },
+            positions, positionIndex);
+        size_t positionCount = positions.size() / 3;
+        normalize(positions);
+
+        // vertices of each position (compressed in a single array)
+        std::vector<unsigned int> vertexOffsets(positionCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexOffsets[positionIndex[v] + 1]++;
+        for (size_t p = 0; p < positionCount; p++)
+            vertexOffsets[p + 1] += vertexOffsets[p];
+        std::vector<unsigned int> positionVertices(vertexCount);
+        std::vector<unsigned int> filled(vertexOffsets.begin(), vertexOffsets.end() - 1);
+        for (size_t v = 0; v < vertexCount; v++)
+            positionVertices[filled[positionIndex[v]]++] = (unsigned int)v;
+
+        std::vector<Quadric> quadrics(positionCount);
+        std::vector<bool> locked(positionCount, false);
+        initialize(result, positionIndex, positions, quadrics, locked);
+
+        std::vector<unsigned int> vertexRemap(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexRemap[v] = (unsigned int)v;
+
+        float limit = targetError * targetError;
+        float maxError = 0.0f;
+        std::vector<Collapse> collapses;
+        std::vector<unsigned int> triangleOffsets;
+        std::vector<unsigned int> positionTriangles;
+        std::vector<bool> touched(positionCount);
+
+        while (result.size() > targetIndexCount)
+        {
+            size_t triangleCount = result.size() / 3;
+            adjacency(result, positionIndex, positionCount, triangleOffsets, positionTriangles);
+
+            // cost of collapsing each edge in the cheapest direction
+            collapses.clear();
+            for (size_t c = 0; c < result.size(); c++)
+            {
+                unsigned int a = positionIndex[result[c]];
+                unsigned int b = positionIndex[result[c - c % 3 + (c + 1) % 3]];
+                if (a > b || a == b || (locked[a] && locked[b]))
+                    continue;
+
+                Collapse collapse;
+                collapse.cost = -1.0f;
+                for (int direction = 0; direction < 2; direction++)
+                {
+                    unsigned int from = direction == 0 ? a : b;
+                    unsigned int to = direction == 0 ? b : a;
+                    if (locked[from])
+                        continue;
+
+                    Quadric quadric = quadrics[from];
+                    quadric.add(quadrics[to]);
+                    float error = quadric.evaluate(&positions[3 * to]);
+                    float cost = error + attributeWeight * attributeCost(vertices, stride, positionVertices, vertexOffsets, from, to, nullptr);
+
+                    if (collapse.cost < 0.0f || cost < collapse.cost)
+                    {
+                        collapse.from = from;
+                        collapse.to = to;
+                        collapse.cost = cost;
+                        collapse.error = error;
+                    }
+                }
+
+                if (collapse.cost >= 0.0f && collapse.error <= limit)
+                    collapses.push_back(collapse);
+            }
+
+            std::sort(collapses.begin(), collapses.end(), [](const Collapse &x, const Collapse &y) { return x.cost < y.cost; });
+
+            // each collapse removes two triangles (one in the borders), stop when the target is reached
+            size_t toRemove = (result.size() - targetIndexCount) / 3;
+            size_t removed = 0;
+            std::fill(touched.begin(), touched.end(), false);
+            for (const Collapse &collapse : collapses)
+            {
+                if (removed >= toRemove)
+                    break;
+                if (touched[collapse.from] || touched[collapse.to])
+                    continue;
+                if (flips(result, positionIndex, positions, triangleOffsets, positionTriangles, collapse.from, collapse.to))
+                    continue;
+
+                // the neighbours of the collapsed position do not move in this pass (the flips check would be wrong)
+                for (unsigned int i = triangleOffsets[collapse.from]; i < triangleOffsets[collapse.from + 1]; i++)
+                {
+                    unsigned int t = positionTriangles[i];
+                    for (int corner = 0; corner < 3; corner++)
+                        touched[positionIndex[result[3 * t + corner]]] = true;
+
+                    bool degenerated = false;
+                    for (int corner = 0; corner < 3; corner++)
+                        degenerated = degenerated || positionIndex[result[3 * t + corner]] == collapse.to;
+                    removed += degenerated;
+                }
+
+                attributeCost(vertices, stride, positionVertices, vertexOffsets, collapse.from, collapse.to, &vertexRemap);
+                quadrics[collapse.to].add(quadrics[collapse.from]);
+                maxError = std::max(maxError, collapse.error);
+            }
+
+            if (removed == 0)
+                break;
+
+            // remove the triangles that lost an edge
+            size_t count = 0;
+            for (size_t t = 0; t < triangleCount; t++)
+            {
+                unsigned int corner[3];
+                for (int i = 0; i < 3; i++)
+                    corner[i] = resolve(vertexRemap, result[3 * t + i]);
+
+                unsigned int p0 = positionIndex[corner[0]], p1 = positionIndex[corner[1]], p2 = positionIndex[corner[2]];
+                if (p0 == p1 || p1 == p2 || p0 == p2)
+                    continue;
+
+                for (int i = 0; i < 3; i++)
+                    result[count++] = corner[i];
+            }
+            result.resize(count);
+        }
+
+        return std::sqrt(maxError);
+    }
+
+private:
+    /**
+     * @brief Symmetric 4x4 matrix of the quadric error of a vertex.
+     *
+     */
+    struct Quadric
+    {
+        //! Upper triangle of the matrix (a00 a01 a02 a03 a11 a12 a13 a22 a23 a33)
+        double m[10] = {0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+
+        //! Sum of the weights of the planes
+        double weight = 0.0;
+
+        /**
+         * @brief Create the quadric of a plane.
+         *
+         * @param a X of the normal of the plane.
+         * @param b Y of the normal of the plane.
+         * @param c Z of the normal of the plane.
+         * @param d Distance of the plane.
+         * @param weight Weight of the plane (area of the triangle).
+         * @return Quadric Quadric of the plane.
+         */
+        static Quadric plane(double a, double b, double c, double d, double weight)
+        {
+            Quadric q;
+            double values[10] = {a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d};
+            for (int i = 0; i < 10; i++)
+                q.m[i] = values[i] * weight;
+            q.weight = weight;
+            return q;
+        }
+
+        /**
+         * @brief Add other quadric to this one.
+         *
+         * @param other Quadric to add.
+         */
+        void add(const Quadric &other)
+        {
+            for (int i = 0; i < 10; i++)
+                m[i] += other.m[i];
+            weight += other.weight;
+        }
+
+        /**
+         * @brief Evaluate the quadric in a point (weighted average of the squared distances to the planes).
+         *
+         * @param p Point.
+         * @return float Error of the point.
+         */
+        [[nodiscard]] float evaluate(const float *p) const
+        {
+            double x = p[0], y = p[1], z = p[2];
+            double error = m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x + m[4] * y * y + 2 * m[5] * y * z +
+                           2 * m[6] * y + m[7] * z * z + 2 * m[8] * z + m[9];
+            return weight > 0.0 ? (float)(std::max(error, 0.0) / weight) : 0.0f;
+        }
+    };
+
+    /**
+     * @brief Collapse of an edge.
+     *
+     */
+    struct Collapse
+    {
+        //! Position that is removed
+        unsigned int from;
+
+        //! Position where the removed one is moved
+        unsigned int to;
+
+        //! Cost of the collapse (geometric error plus the difference of the attributes)
+        float cost;
+
+        //! Geometric error of the collapse (squared distance)
+        float error;
+    };
+
+    /**
+     * @brief Scale the positions to the unit cube, so the errors are relative to the size of the mesh.
+     *
+     * @param positions Positions (x, y, z).
+     */
+    static void normalize(std::vector<float> &positions)
+    {
+        float minimum[3] = {positions[0], positions[1], positions[2]};
+        float extent = 0.0f;
+        for (size_t i = 0; i < positions.size(); i++)
+            minimum[i % 3] = std::min(minimum[i % 3], positions[i]);
+        for (size_t i = 0; i < positions.size(); i++)
+            extent = std::max(extent, positions[i] - minimum[i % 3]);
+
+        float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+        for (size_t i = 0; i < positions.size(); i++)
+            positions[i] = (positions[i] - minimum[i % 3]) * scale;
+    }
+
+    /**
+     * @brief Calculate the quadrics of the positions and lock the ones of the borders.
+     *
+     * An edge is in the border if there is no triangle that uses it in the opposite direction.
+     *
+     * @param indices Index buffer.
+     * @param positionIndex Position of each vertex.
+     * @param positions Positions.
+     * @param quadrics Quadric of each position.
+     * @param locked Positions that can not move.
+     */
+    static void initialize(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &positionIndex,
+                           const std::vector<float> &positions, std::vector<Quadric> &quadrics, std::vector<bool> &locked)
+    {
+        std::vector<uint64_t> edges;
+        edges.reserve(indices.size());
+        for (size_t t = 0; t < indices.size(); t += 3)
+        {
+            unsigned int p[3] = {positionIndex[indices[t]], positionIndex[indices[t + 1]], positionIndex[indices[t + 2]]};
+            for (int i = 0; i < 3; i++)
+                edges.push_back(((uint64_t)p[i] << 32) | p[(i + 1) % 3]);
+
+            const float *p0 = &positions[3 * p[0]];
+            const float *p1 = &positions[3 * p[1]];
+            const float *p2 = &positions[3 * p[2]];
+            double e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+            double e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+            double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            double length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length == 0.0)
+                continue;
+
+            // weighted by the area, big triangles are more important
+            for (double &value : n)
+                value /= length;
+            Quadric quadric = Quadric::plane(n[0], n[1], n[2], -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]), length * 0.5);
+            for (unsigned int position : p)
+                quadrics[position].add(quadric);
+        }
+
+        std::sort(edges.begin(), edges.end());
+        for (uint64_t edge : edges)
+        {
+            uint64_t opposite = (edge << 32) | (edge >> 32);
+            if (!std::binary_search(edges.begin(), edges.end(), opposite))
+            {
+                locked[edge >> 32] = true;
+                locked[edge & 0xffffffffu] = true;
+            }
+        }
+    }
+
+    /**
+     * @brief Build the list of triangles of each position.
+     *
+     * @param indices Index buffer.
+     * @param positionIndex Position of each vertex.
+     * @param positionCount Number of positions.
+     * @param offsets Offset in triangles of the list of each position.
+     * @param triangles Lists of triangles.
+     */
+    static void adjacency(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &positionIndex, size_t positionCount,
+                          std::vector<unsigned int> &offsets, std::vector<unsigned int> &triangles)
+    {
+        offsets.assign(positionCount + 1, 0);
+        for (unsigned int index : indices)
+            offsets[positionIndex[index] + 1]++;
+        for (size_t p = 0; p < positionCount; p++)
+            offsets[p + 1] += offsets[p];
+
+        triangles.resize(indices.size());
+        std::vector<unsigned int> filled(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            triangles[filled[positionIndex[indices[i]]]++] = (unsigned int)(i / 3);
+    }
+
+    /**
+     * @brief Calculate the difference of attributes when a position is collapsed to other.
+     *
+     * Each vertex of the removed position is merged with the vertex of the other position with
+     * the nearest attributes.
+     *
+     * @param vertices Vertices of the mesh.
+     * @param stride Number of floats of each vertex.
+     * @param positionVertices Vertices of each position.
+     * @param offsets Offset of the vertices of each position.
+     * @param from Position removed.
+     * @param to Position where the removed one is moved.
+     * @param remap If not nullptr the vertex chosen for each vertex of from is stored in it.
+     * @return float Maximum squared difference of the attributes of the merged vertices.
+     */
+    static float attributeCost(const std::vector<float> &vertices, size_t stride, const std::vector<unsigned int> &positionVertices,
+                               const std::vector<unsigned int> &offsets, unsigned int from, unsigned int to, std::vector<unsigned int> *remap)
+    {
+        float cost = 0.0f;
+        for (unsigned int i = offsets[from]; i < offsets[from + 1]; i++)
+        {
+            unsigned int v = positionVertices[i];
+            float best = -1.0f;
+            unsigned int bestVertex = v;
+            for (unsigned int j = offsets[to]; j < offsets[to + 1]; j++)
+            {
+                unsigned int u = positionVertices[j];
+                float distance = 0.0f;
+                for (size_t k = 3; k < stride; k++)
+                {
+                    float difference = vertices[stride * v + k] - vertices[stride * u + k];
+                    distance += difference * difference;
+                }
+
+                if (best < 0.0f || distance < best)
+                {
+                    best = distance;
+                    bestVertex = u;
+                }
+            }
+
+            cost = std::max(cost, best);
+            if (remap != nullptr)
+                (*remap)[v] = bestVertex;
+        }
+
+        return cost;
+    }
+
+    /**
+     * @brief Check if collapsing a position flips any of the triangles around it.
+     *
+     * @param indices Index buffer.
+     * @param positionIndex Position of each vertex.
+     * @param positions Positions.
+     * @param offsets Offset of the triangles of each position.
+     * @param triangles Triangles of each position.
+     * @param from Position removed.
+     * @param to Position where the removed one is moved.
+     * @return true If a triangle changes its orientation.
+     */
+    static bool flips(const std::vector<unsigned int> &indices, const std::vector<unsigned int> &positionIndex,
+                      const std::vector<float> &positions, const std::vector<unsigned int> &offsets,
+                      const std::vector<unsigned int> &triangles, unsigned int from, unsigned int to)
+    {
+        for (unsigned int i = offsets[from]; i < offsets[from + 1]; i++)
+        {
+            unsigned int t = triangles[i];
+            unsigned int p[3] = {positionIndex[indices[3 * t]], positionIndex[indices[3 * t + 1]], positionIndex[indices[3 * t + 2]]};
+            if (p[0] == to || p[1] == to || p[2] == to)
+                continue;
+
+            float before[3], after[3];
+            normal(positions, p, before);
+            for (unsigned int &position : p)
+                position = position == from ? to : position;
+            normal(positions, p, after);
+
+            if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= 0.0f)
+                return true;
+        }
+
+        return false;
+    }
+
+    /**
+     * @brief Calculate the (not normalized) normal of a triangle.
+     *
+     * @param positions Positions.
+     * @param p Positions of the corners.
+     * @param n Normal.
+     */
+    static void normal(const std::vector<float> &positions, const unsigned int p[3], float n[3])
+    {
+        const float *p0 = &positions[3 * p[0]];
+        const float *p1 = &positions[3 * p[1]];
+        const float *p2 = &positions[3 * p[2]];
+        float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+        float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    }
+
+    /**
+     * @brief Get the final vertex of a vertex after all the collapses.
+     *
+     * @param remap Vertex where each vertex was merged (itself if it was not merged).
+     * @param v Vertex.
+     * @return unsigned int Final vertex.
+     */
+    static unsigned int resolve(std::vector<unsigned int> &remap, unsigned int v)
+    {
+        unsigned int root = v;
+        while (remap[root] != root)
+            root = remap[root];
+
+        // path compression, the next searches are direct
+        while (remap[v] != root)
+        {
+            unsigned int next = remap[v];
+            remap[v] = root;
+            v = next;
+        }
+        return root;
+    }
+};
+
+#endif //RENDERENGINE_MESHSIMPLIFIER_H
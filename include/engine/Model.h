@@ -11,7 +11,21 @@
 
 #include <glm/gtc/matrix_transform.hpp>
 #include <Model.h>
-#include <Utils.h>
+#include <ObjParser.h>
+#include <MappedFile.h>
+#include <MeshOptimizer.h>
+#include <MeshCache.h>
+#include <GeometryRegistry.h>
+#include <MeshSimplifier.h>
+#include <VertexLayout.h>
+#include <VertexQuantizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <cstdio>
+#include <iostream>
 
 /**
  * @brief Struct to manage the rotation of the models.
@@ -31,11 +45,54 @@ struct Rotation
     float z;
 };
 
+/**
+ * @brief Options used by the Model to load the files.
+ * 
+ */
+struct LoadOptions
+{
+    //! Memory-map the file instead of reading it into a buffer
+    bool memoryMap = true;
+
+    //! Maximum number of threads used to parse the file (0 to use all the threads)
+    unsigned int threads = 0;
+
+    //! Use the binary cache (.rmesh) of the file, creating it if it does not exist
+    bool useCache = true;
+
+    //! Directory where the cache files are stored (if empty they are stored next to the files)
+    std::string cacheDirectory;
+
+    //! Reorder the triangles and the vertex for the GPU caches (see MeshOptimizer)
+    bool optimize = true;
+
+    //! Split the triangles in meshlets, so the parts of the model that are not visible are not drawn
+    bool meshlets = true;
+
+    //! Number of simplified levels of detail generated after the original geometry (0 to not generate them)
+    unsigned int lodLevels = 3;
+
+    //! Triangles of each level of detail relative to the previous one
+    float lodRatio = 0.5f;
+
+    //! Maximum error of the levels of detail relative to the size of the model (the chain stops when it is reached)
+    float lodError = 0.05f;
+
+    //! Format of the vertex in the GPU, the quantized formats use less memory but lose precision
+    VertexFormat format = VERTEX_FORMAT_FLOAT;
+
+    //! Print the vertex cache efficiency and the quantization error of the model
+    bool report = true;
+
+    //! Share the geometry with the models that loaded the same file with the same options (see GeometryRegistry)
+    bool shareGeometry = true;
+};
+
 /**
  * @brief General class that has all the elements that must be draw in the scene.
  * 
  * For an element to be draw it must have 3 attributes:
- *      - Vector with the vertices.
+ *      - Vector with the vertices (all the attributes of each vertex together, see VertexLayout).
  *      - A pointer to the shaders to be used.
  *      - Position of the model in the scene.
  * 
@@ -49,8 +106,8 @@ class Model
 private:
     /* Parametros que deben ser modificados para poder usarlos */
 
-    //! Pointer to the shader to use
-    Shader *shader;
+    //! Shader to use (shared with the other models that use it)
+    std::shared_ptr<Shader> shader;
 
     //! Position of the model
     glm::vec3 pos;
@@ -58,12 +115,12 @@ private:
     //! Rotation of the model
     Rotation rot{};
 
-    //! vector of vertex to be draw
-    std::vector<float> vertex;
-
     //! vector of the colors of each vertex
     std::vector<float> colors;
 
+    //! geometry of the model (vertex, indices, meshlets and levels of detail), shared with the models that have the same one
+    std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>();
+
     //! type of drawing to be used by openGL (usually GL_TRIANGLES)
     GLint drawType;
 
@@ -75,77 +132,451 @@ private:
      * 
      * Method to load a .obj file.
      * 
-     * Load all the characteristic of the .obj into the parameters of the model.
-     * TODO: load ALL the characteristic into the model. (currently only load the vertex and
-     * the first parameter of the face), to do this its necessary to add material to the engine.
+     * Load all the characteristic of the .obj into the parameters of the model. The model
+     * is indexed, the vertex vector only has the unique vertices of the file (with normal and
+     * texture coordinate if the file has them) and the geometry is reordered for the GPU
+     * (see optimize).
+     * TODO: load ALL the characteristic into the model. (currently only load the geometry),
+     * to do this its necessary to add material to the engine.
+     * 
+     * The content of the file is parsed with the ObjParser directly from the MappedFile
+     * (in parallel for big files). If the binary cache of the file is valid the geometry is
+     * taken from it, in other case the cache is written after parsing the file.
      * 
      * @param filename Name of the file.
+     * @param options Options used to load the file.
+     * @return true If the file was loaded.
      */
-    void load_obj(std::string filename)
+    bool load_obj(std::string filename, const LoadOptions &options)
     {
-        std::ifstream infile(filename);
-        std::string line = "";
-        std::vector<std::string> parsed_line;
+        std::string cacheFile = MeshCache::cachePath(filename, options.cacheDirectory);
+        if (options.useCache && this->load_cache(cacheFile, filename, options))
+        {
+            return true;
+        }
+
+        MappedFile file;
+        if (!file.open(filename, options.memoryMap))
+        {
+            this->error("Model could not be loaded. File " + filename + " could not be opened...");
+            return false;
+        }
+
+        ObjData data;
+        ObjParser::parse(file.view(), data, options.threads);
+
+        if (data.invalidFaces > 0)
+        {
+            this->error("File " + filename + " has " + std::to_string(data.invalidFaces) + " invalid faces...");
+        }
 
-        std::vector<std::vector<float>> vertices;
-        std::vector<std::vector<int>> faces;
+        // the attributes of the file that are not in a corner are set to 0
+        bool hasNormal = data.count(OBJ_NORMAL) > 0;
+        bool hasTexcoord = data.count(OBJ_TEXCOORD) > 0;
+        this->geometry->layout = VertexLayout::floats(false, hasNormal, hasTexcoord);
 
-        while (std::getline(infile, line))
+        // vertices with exactly the same data (position, normal and texture coordinate) are shared by the triangles
+        MeshOptimizer::indexVertices(
+            data.triangles.size(), this->getVertexFloats(),
+            [&data, hasNormal, hasTexcoord](size_t corner, float *vertex) {
+                for (ObjAttribute attribute : {OBJ_POSITION, OBJ_NORMAL, OBJ_TEXCOORD})
+                {
+                    if ((attribute == OBJ_NORMAL && !hasNormal) || (attribute == OBJ_TEXCOORD && !hasTexcoord))
+                        continue;
+
+                    unsigned int index = data.triangles[corner].index[attribute];
+                    for (size_t i = 0; i < OBJ_ATTRIBUTE_SIZE[attribute]; i++)
+                        *vertex++ = index == OBJ_NONE ? 0.0f : data.attributes[attribute][OBJ_ATTRIBUTE_SIZE[attribute] * index + i];
+                }
+            },
+            this->geometry->vertex, this->geometry->indices);
+        this->geometry->cache = MeshCacheView();
+
+        // the meshlets and the levels of detail need the float positions, so they are built before the quantization
+        this->optimize(filename, options);
+        this->buildLods(filename, options);
+        this->updateBounds();
+
+        if (options.format != VERTEX_FORMAT_FLOAT)
         {
+            this->quantize(filename, options.format, options.report);
+        }
 
-            parsed_line = split(line, ' ');
-            if (parsed_line.size() == 0)
+        if (options.useCache)
+        {
+            MeshCacheHeader header = MeshCacheHeader();
+            header.key.sourceHash = hashBytes(file.data(), file.size());
+            MeshCache::sourceKey(filename, header.key);
+            header.stride = (uint32_t)this->geometry->layout.stride;
+            header.attributes = this->geometry->layout.mask();
+            header.format = (uint32_t)this->geometry->layout.format;
+            header.indexSize = this->getIndexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+            header.vertexCount = this->getVertexCount();
+            header.indexCount = this->getIndexCount();
+            header.meshletCount = this->geometry->meshlets.size();
+            header.lodCount = this->geometry->lods.size();
+            for (int i = 0; i < 3; i++)
             {
-                continue;
+                header.boundsMin[i] = this->geometry->boundsMin[i];
+                header.boundsMax[i] = this->geometry->boundsMax[i];
             }
+            header.boundsRadius = this->geometry->boundsRadius;
+            header.optionsHash = this->optionsHash(options);
 
-            if (parsed_line[0].compare("v") == 0)
-            {
-                std::vector<float> new_vertex;
-                new_vertex.push_back(std::stof(parsed_line[1]));
-                new_vertex.push_back(std::stof(parsed_line[2]));
-                new_vertex.push_back(std::stof(parsed_line[3]));
+            std::vector<GLushort> buffer;
+            if (!MeshCache::write(cacheFile, header, this->getVertexData(), this->getIndexData(buffer), this->geometry->meshlets.data(),
+                                  this->geometry->lods.data()))
+                this->error("Cache file " + cacheFile + " could not be written...");
+        }
 
-                vertices.push_back(new_vertex);
-            }
+        return true;
+    }
+
+    /**
+     * @brief Load the geometry of a file from its binary cache.
+     * 
+     * The vertex and the indices are not copied, the model keeps the cache file mapped
+     * and they are uploaded to the GPU directly from the mapping.
+     * 
+     * @param cacheFile Path to the cache file.
+     * @param filename Name of the file that generated the cache.
+     * @param options Options used to load the file.
+     * @return true If the cache was valid and it was loaded.
+     */
+    bool load_cache(const std::string &cacheFile, const std::string &filename, const LoadOptions &options)
+    {
+        MeshCacheView view;
+        if (!MeshCache::read(cacheFile, filename, view, options.memoryMap))
+            return false;
 
-            if (parsed_line[0].compare("f") == 0)
+        // the cache must be built with the options that change the geometry (format, optimization, meshlets and levels of detail)
+        if (view.header->optionsHash != this->optionsHash(options) || view.header->format != (uint32_t)options.format)
+            return false;
+
+        uint32_t attributes = view.header->attributes;
+        VertexLayout cacheLayout = VertexLayout::create(options.format, attributes & (1u << ATTRIBUTE_COLOR),
+                                                        attributes & (1u << ATTRIBUTE_NORMAL), attributes & (1u << ATTRIBUTE_TEXCOORD));
+        size_t indexSize = view.header->vertexCount <= 65536 ? sizeof(GLushort) : sizeof(GLuint);
+        if (cacheLayout.mask() != attributes || view.header->stride != (uint32_t)cacheLayout.stride || view.header->indexSize != indexSize)
+            return false;
+
+        this->geometry->layout = cacheLayout;
+        this->geometry->vertex.clear();
+        this->geometry->packed.clear();
+        this->geometry->indices.clear();
+        this->geometry->cache = view;
+        this->geometry->meshlets.clear();
+        if (options.meshlets)
+            this->geometry->meshlets.assign(view.meshlets, view.meshlets + view.header->meshletCount);
+        this->geometry->lods.clear();
+        if (options.lodLevels > 0)
+            this->geometry->lods.assign(view.lods, view.lods + std::min<size_t>(view.header->lodCount, options.lodLevels + 1));
+        this->geometry->boundsMin = glm::vec3(view.header->boundsMin[0], view.header->boundsMin[1], view.header->boundsMin[2]);
+        this->geometry->boundsMax = glm::vec3(view.header->boundsMax[0], view.header->boundsMax[1], view.header->boundsMax[2]);
+        this->geometry->boundsRadius = view.header->boundsRadius;
+        return true;
+    }
+
+    /**
+     * @brief Reorder the geometry of the model for the GPU.
+     * 
+     * The triangles are reordered for the post-transform vertex cache and then by clusters
+     * to reduce the overdraw, then they are grouped in meshlets and finally the vertex are
+     * sorted in the order of use. Each step is done only if it is enabled in the options. The
+     * result is stored in the binary cache, so it is only done the first time that a file is
+     * loaded.
+     * 
+     * @param filename Name of the file of the model (used in the report).
+     * @param options Options used to load the file.
+     */
+    void optimize(const std::string &filename, const LoadOptions &options)
+    {
+        size_t floats = this->getVertexFloats();
+        size_t vertexCount = this->getVertexCount();
+        VertexCacheStatistics before = MeshOptimizer::analyzeVertexCache(this->geometry->indices, vertexCount);
+
+        if (options.optimize)
+        {
+            std::vector<unsigned int> clusters;
+            MeshOptimizer::optimizeVertexCache(this->geometry->indices, vertexCount, &clusters);
+            MeshOptimizer::optimizeOverdraw(this->geometry->indices, this->geometry->vertex, floats, clusters);
+        }
+
+        this->geometry->meshlets.clear();
+        if (options.meshlets && this->drawType == GL_TRIANGLES)
+        {
+            MeshOptimizer::buildMeshlets(this->geometry->indices, this->geometry->vertex, floats, this->geometry->meshlets);
+        }
+
+        if (options.optimize)
+        {
+            MeshOptimizer::optimizeVertexFetch(this->geometry->vertex, floats, this->geometry->indices);
+        }
+
+        if (options.report)
+        {
+            VertexCacheStatistics after = MeshOptimizer::analyzeVertexCache(this->geometry->indices, this->getVertexCount());
+            char message[256];
+            std::snprintf(message, sizeof(message), "%s: %zu vertex, %zu triangles, %zu meshlets, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f",
+                          filename.c_str(), this->getVertexCount(), this->geometry->indices.size() / 3,
+                          this->geometry->meshlets.size(), before.acmr, after.acmr, before.atvr, after.atvr);
+            this->info(message);
+        }
+    }
+
+    /**
+     * @brief Generate the levels of detail of the model.
+     * 
+     * Each level is simplified from the previous one (see MeshSimplifier) and its indices are
+     * added at the end of the index buffer, so all the levels use the same buffers in the GPU.
+     * The chain stops when a level can not be simplified without exceeding the error limit.
+     * 
+     * @param filename Name of the file of the model (used in the report).
+     * @param options Options used to load the file.
+     */
+    void buildLods(const std::string &filename, const LoadOptions &options)
+    {
+        this->geometry->lods.clear();
+        if (options.lodLevels == 0 || this->geometry->indices.empty() || this->drawType != GL_TRIANGLES)
+            return;
+
+        size_t floats = this->getVertexFloats();
+        size_t baseCount = this->geometry->indices.size();
+        this->geometry->lods.push_back({0, (uint32_t)baseCount, 0.0f});
+
+        std::vector<unsigned int> previous(this->geometry->indices);
+        std::vector<unsigned int> level;
+        float error = 0.0f;
+        for (unsigned int i = 1; i <= options.lodLevels; i++)
+        {
+            size_t target = (size_t)((float)(previous.size() / 3) * options.lodRatio) * 3;
+            // the errors of the levels are accumulated, each one is relative to the previous level
+            error += MeshSimplifier::simplify(previous, this->geometry->vertex, floats, target, options.lodError - error, level);
+            if (level.size() >= previous.size() * 95 / 100)
+                break;
+
+            MeshOptimizer::optimizeVertexCache(level, this->getVertexCount());
+            this->geometry->lods.push_back({(uint32_t)this->geometry->indices.size(), (uint32_t)level.size(), error});
+            this->geometry->indices.insert(this->geometry->indices.end(), level.begin(), level.end());
+            previous.swap(level);
+
+            if (options.report)
             {
-                std::vector<int> face;
+                char message[256];
+                std::snprintf(message, sizeof(message), "%s: LOD %u, %zu triangles (%.1f%% of the original), error %.5f", filename.c_str(),
+                              i, previous.size() / 3, 100.0 * (double)previous.size() / (double)baseCount, error);
+                this->info(message);
+            }
+        }
 
-                for (int i = 1; i < parsed_line.size(); i++)
-                {
-                    // faces can also have this format: f 6/4/1 3/5/3 7/6/5
-                    std::string pos_vertex = split(parsed_line[i], '/')[0];
+        // a chain without simplified levels is not needed
+        if (this->geometry->lods.size() == 1)
+            this->geometry->lods.clear();
+    }
 
-                    face.push_back(std::stoi(pos_vertex));
-                }
+    /**
+     * @brief Convert the vertex of the model to a quantized format.
+     * 
+     * The bounding box of the model must be already calculated, the positions are stored
+     * relative to it (see getDequantizationMatrix).
+     * 
+     * @param filename Name of the file of the model (used in the report).
+     * @param format Quantized format of the vertex.
+     * @param report If true the size and the error of the quantization are printed.
+     */
+    void quantize(const std::string &filename, VertexFormat format, bool report)
+    {
+        VertexLayout quantized = VertexLayout::create(format, this->geometry->layout.find(ATTRIBUTE_COLOR) != nullptr,
+                                                      this->geometry->layout.find(ATTRIBUTE_NORMAL) != nullptr,
+                                                      this->geometry->layout.find(ATTRIBUTE_TEXCOORD) != nullptr);
+
+        QuantizationReport result = VertexQuantizer::quantize(this->geometry->vertex.data(), this->getVertexCount(), this->geometry->layout,
+                                                              quantized, this->geometry->boundsMin, this->geometry->boundsMax,
+                                                              this->geometry->packed);
+        this->geometry->layout = quantized;
+        this->geometry->vertex.clear();
+        this->geometry->vertex.shrink_to_fit();
 
-                faces.push_back(face);
+        if (report)
+        {
+            char message[256];
+            std::snprintf(message, sizeof(message),
+                          "%s: quantized vertex %zu -> %zu bytes, max error position %g, normal %.3f deg, texcoord %g",
+                          filename.c_str(), result.sourceBytes, result.quantizedBytes, result.positionError, result.normalError,
+                          result.texcoordError);
+            this->info(message);
+        }
+    }
+
+    /**
+     * @brief Calculate the bounding box and the bounding sphere of the vertex of the model.
+     * 
+     * The sphere is centered in the box, its radius is the distance to the farthest vertex
+     * (it is usually much smaller than half the diagonal of the box).
+     */
+    void updateBounds()
+    {
+        const std::vector<float> &vertex = this->geometry->vertex;
+        if (vertex.size() < 3)
+        {
+            this->geometry->boundsMin = this->geometry->boundsMax = glm::vec3(0);
+            this->geometry->boundsRadius = 0.0f;
+            return;
+        }
+
+        // the position is always the first attribute of the vertex
+        size_t floats = this->getVertexFloats();
+        glm::vec3 boundsMin = glm::vec3(vertex[0], vertex[1], vertex[2]);
+        glm::vec3 boundsMax = boundsMin;
+        for (size_t i = floats; i + 2 < vertex.size(); i += floats)
+        {
+            glm::vec3 position(vertex[i], vertex[i + 1], vertex[i + 2]);
+            boundsMin = glm::min(boundsMin, position);
+            boundsMax = glm::max(boundsMax, position);
+        }
+
+        glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+        float radius2 = 0.0f;
+        for (size_t i = 0; i + 2 < vertex.size(); i += floats)
+        {
+            glm::vec3 offset = glm::vec3(vertex[i], vertex[i + 1], vertex[i + 2]) - center;
+            radius2 = std::max(radius2, glm::dot(offset, offset));
+        }
+
+        this->geometry->boundsMin = boundsMin;
+        this->geometry->boundsMax = boundsMax;
+        this->geometry->boundsRadius = std::sqrt(radius2);
+    }
+
+    /**
+     * @brief Put the colors in the vertex of the model.
+     * 
+     * If the model has a color for each vertex it is added to the vertex (or it replaces the
+     * previous one), in other case the color is removed. The other attributes of the vertex
+     * (normal and texture coordinate) are kept.
+     */
+    void interleaveColors()
+    {
+        const VertexLayout &layout = this->geometry->layout;
+        size_t floats = this->getVertexFloats();
+        size_t count = this->geometry->vertex.size() / floats;
+        bool withColors = !this->colors.empty() && this->colors.size() == count * 3;
+        uint32_t mask = layout.mask();
+        VertexLayout newLayout = VertexLayout::floats(withColors, mask & (1u << ATTRIBUTE_NORMAL), mask & (1u << ATTRIBUTE_TEXCOORD));
+
+        if (newLayout.mask() == mask)
+        {
+            // only the colors change
+            if (withColors)
+            {
+                size_t color = newLayout.attributes[1].offset / sizeof(float);
+                for (size_t i = 0; i < count; i++)
+                    std::copy(&this->colors[3 * i], &this->colors[3 * i] + 3, &this->geometry->vertex[floats * i + color]);
             }
+            return;
         }
 
-        std::vector<float> vertices_triangles;
-        for (std::vector<int> face : faces)
+        // each attribute of the new layout is copied from the old vertex, the color from the colors
+        size_t newFloats = newLayout.stride / sizeof(float);
+        std::vector<float> newVertex(count * newFloats, 0.0f);
+        for (const VertexAttribute &attribute : newLayout.attributes)
         {
-            for (int i = 1; i + 1 < face.size(); i++)
+            size_t target = attribute.offset / sizeof(float);
+            const float *source = attribute.location == ATTRIBUTE_COLOR ? this->colors.data() : nullptr;
+            size_t sourceOffset = 0;
+            size_t sourceStride = 3;
+            for (const VertexAttribute &old : layout.attributes)
             {
-                // indexes in the faces start from 1 and not from 0
-                vertices_triangles.push_back(vertices[face[0] - 1][0]);
-                vertices_triangles.push_back(vertices[face[0] - 1][1]);
-                vertices_triangles.push_back(vertices[face[0] - 1][2]);
-
-                vertices_triangles.push_back(vertices[face[i] - 1][0]);
-                vertices_triangles.push_back(vertices[face[i] - 1][1]);
-                vertices_triangles.push_back(vertices[face[i] - 1][2]);
-
-                vertices_triangles.push_back(vertices[face[i + 1] - 1][0]);
-                vertices_triangles.push_back(vertices[face[i + 1] - 1][1]);
-                vertices_triangles.push_back(vertices[face[i + 1] - 1][2]);
+                if (old.location == attribute.location && attribute.location != ATTRIBUTE_COLOR)
+                {
+                    source = this->geometry->vertex.data();
+                    sourceOffset = old.offset / sizeof(float);
+                    sourceStride = floats;
+                }
             }
+
+            for (size_t i = 0; i < count; i++)
+                std::copy(source + sourceStride * i + sourceOffset, source + sourceStride * i + sourceOffset + attribute.size,
+                          &newVertex[newFloats * i + target]);
+        }
+
+        this->geometry->vertex = std::move(newVertex);
+        this->geometry->layout = newLayout;
+    }
+
+    /**
+     * @brief Get the geometry of the model to modify it.
+     * 
+     * If the geometry is in the registry other models can be using it, so it is copied
+     * before (copy on write). After the changes it must be shared again (see shareGeometry).
+     * 
+     * @return Geometry& Geometry of the model that only this model uses.
+     */
+    Geometry &editGeometry()
+    {
+        if (this->geometry->registered)
+        {
+            this->geometry = std::make_shared<Geometry>(*this->geometry);
+            this->geometry->registered = false;
         }
 
-        this->vertex = vertices_triangles;
+        return *this->geometry;
+    }
+
+    /**
+     * @brief Replace the geometry of the model by the registered one with the same content.
+     * 
+     */
+    void shareGeometry()
+    {
+        this->geometry = GeometryRegistry::shared().share(this->geometry);
+    }
+
+    /**
+     * @brief Get the key of a file in the GeometryRegistry.
+     * 
+     * The key has the path, the size and the modification time of the file (a changed file
+     * is loaded again) and the options that change the geometry.
+     * 
+     * @param filename Name of the file.
+     * @param options Options used to load the file.
+     * @return std::string Key of the file (empty if the file does not exist).
+     */
+    std::string geometryKey(const std::string &filename, const LoadOptions &options) const
+    {
+        MeshCacheKey source;
+        if (!MeshCache::sourceKey(filename, source))
+            return "";
+
+        char key[64];
+        std::snprintf(key, sizeof(key), "|%llu|%lld|", (unsigned long long)source.sourceSize, (long long)source.sourceTime);
+        return filename + key + this->optionsKey(options);
+    }
+
+    /**
+     * @brief Get the options that change the geometry built from a file.
+     * 
+     * @param options Options used to load the file.
+     * @return std::string Draw type, format, optimization, meshlets and levels of detail.
+     */
+    std::string optionsKey(const LoadOptions &options) const
+    {
+        char key[128];
+        std::snprintf(key, sizeof(key), "%d|%d|%d|%d|%u|%g|%g", (int)this->drawType, (int)options.format, (int)options.optimize,
+                      (int)options.meshlets, options.lodLevels, options.lodRatio, options.lodError);
+        return key;
+    }
+
+    /**
+     * @brief Get the hash of the options that change the geometry, stored in the binary cache.
+     * 
+     * @param options Options used to load the file.
+     * @return uint64_t Hash of optionsKey.
+     */
+    uint64_t optionsHash(const LoadOptions &options) const
+    {
+        std::string key = this->optionsKey(options);
+        return hashBytes(key.data(), key.size());
     }
 
 public:
@@ -178,8 +609,7 @@ public:
     virtual ~Model()
     {
 
-        // must delete the shader
-        delete this->shader;
+        // the shader is released with the last model (or owner) that uses it
     }
 
     /**
@@ -203,24 +633,248 @@ public:
         return model;
     }
 
+    /**
+     * @brief Get the matrix that converts the positions of the vertex to model coordinates.
+     * 
+     * The quantized formats store the positions normalized inside the bounding box, this
+     * matrix must be applied before the model matrix. For float vertex it is the identity.
+     * 
+     * @return glm::mat4 Dequantization matrix of the positions.
+     */
+    [[nodiscard]] glm::mat4 getDequantizationMatrix() const
+    {
+        if (geometry->layout.format == VERTEX_FORMAT_FLOAT)
+            return glm::mat4(1.0f);
+
+        glm::mat4 matrix = glm::translate(glm::mat4(1.0f), geometry->boundsMin);
+        return glm::scale(matrix, geometry->boundsMax - geometry->boundsMin);
+    }
+
     /**
      * @brief Get the Vertex object
      * 
+     * The vector is empty if the model was loaded from the binary cache or if the vertex are
+     * quantized, use getVertexData to access the vertex in all the cases.
+     * 
      * @return const std::vector<float>& Vertex vector of the model.
      */
     [[nodiscard]] const std::vector<float> &getVertex() const
     {
-        return vertex;
+        return geometry->vertex;
     }
 
     /**
      * @brief Set the Vertex object
      * 
-     * @param vector Vector of vertex to be used in the model.
+     * If other model has the same vertex (and colors) the geometry is shared with it.
+     * 
+     * @param vector Vector with the positions (three floats per vertex) to be used in the model.
      */
     void setVertex(const std::vector<float> &vector)
     {
-        this->vertex = vector;
+        this->geometry = std::make_shared<Geometry>();
+        this->geometry->vertex = vector;
+        this->interleaveColors();
+        this->updateBounds();
+        this->shareGeometry();
+    }
+
+    /**
+     * @brief Get the Geometry object
+     * 
+     * The geometry can be shared with other models, the Scene uploads it only once.
+     * 
+     * @return std::shared_ptr<const Geometry> Geometry of the model.
+     */
+    [[nodiscard]] std::shared_ptr<const Geometry> getGeometry() const
+    {
+        return geometry;
+    }
+
+    /**
+     * @brief Get the Layout object
+     * 
+     * @return const VertexLayout& Format of the vertex of the model.
+     */
+    [[nodiscard]] const VertexLayout &getLayout() const
+    {
+        return geometry->layout;
+    }
+
+    /**
+     * @brief Get the number of floats of each vertex.
+     * 
+     * For the quantized formats it is the size of the vertex in 4 bytes words.
+     * 
+     * @return size_t Number of floats of each vertex.
+     */
+    [[nodiscard]] size_t getVertexFloats() const
+    {
+        return (size_t)geometry->layout.stride / sizeof(float);
+    }
+
+    /**
+     * @brief Get the pointer to the vertex of the model.
+     * 
+     * @return const void* Pointer to the vertex (getVertexCount vertex of getLayout().stride bytes).
+     */
+    [[nodiscard]] const void *getVertexData() const
+    {
+        return geometry->vertexData();
+    }
+
+    /**
+     * @brief Get the number of vertex of the model.
+     * 
+     * @return size_t Number of vertex (each one uses getVertexFloats floats of the vertex vector).
+     */
+    [[nodiscard]] size_t getVertexCount() const
+    {
+        return geometry->vertexCount();
+    }
+
+    /**
+     * @brief Get the Indices object
+     * 
+     * The vector is empty if the model was loaded from the binary cache, use getIndexData
+     * to access the indices in all the cases.
+     * 
+     * @return const std::vector<unsigned int>& Index of the vertex used by each corner of the primitives.
+     */
+    [[nodiscard]] const std::vector<unsigned int> &getIndices() const
+    {
+        return geometry->indices;
+    }
+
+    /**
+     * @brief Set the Indices object
+     * 
+     * If the vector is empty the vertex are drawn in order.
+     * 
+     * @param vector Index of the vertex used by each corner of the primitives.
+     */
+    void setIndices(const std::vector<unsigned int> &vector)
+    {
+        Geometry &edited = this->editGeometry();
+        if (edited.cache.header != nullptr)
+        {
+            // keep the vertex of the cache, the indices must refer to them
+            const uint8_t *data = (const uint8_t *)edited.cache.vertex;
+            size_t bytes = edited.vertexCount() * edited.layout.stride;
+            if (edited.layout.format != VERTEX_FORMAT_FLOAT)
+                edited.packed.assign(data, data + bytes);
+            else
+                edited.vertex.assign((const float *)data, (const float *)(data + bytes));
+            edited.cache = MeshCacheView();
+        }
+        edited.indices = vector;
+        edited.meshlets.clear();
+        edited.lods.clear();
+        this->shareGeometry();
+    }
+
+    /**
+     * @brief Get the Meshlets object
+     * 
+     * @return const std::vector<Meshlet>& Clusters of triangles of the model (empty if the model does not use them).
+     */
+    [[nodiscard]] const std::vector<Meshlet> &getMeshlets() const
+    {
+        return geometry->meshlets;
+    }
+
+    /**
+     * @brief Get the number of levels of detail of the model.
+     * 
+     * @return size_t Number of levels (1 if the model only has the original geometry).
+     */
+    [[nodiscard]] size_t getLodCount() const
+    {
+        return geometry->lods.empty() ? 1 : geometry->lods.size();
+    }
+
+    /**
+     * @brief Get a level of detail of the model.
+     * 
+     * The level 0 is the original geometry, the meshlets only cover it.
+     * 
+     * @param level Level of detail (the last one is returned if it is bigger than the number of levels).
+     * @return MeshLod Range of the index buffer of the level (the whole buffer if the model does not have levels).
+     */
+    [[nodiscard]] MeshLod getLod(size_t level) const
+    {
+        const std::vector<MeshLod> &lods = geometry->lods;
+        if (lods.empty())
+            return {0, (uint32_t)getIndexCount(), 0.0f};
+
+        return lods[std::min(level, lods.size() - 1)];
+    }
+
+    /**
+     * @brief Get the number of indices of the model.
+     * 
+     * The index buffer contains all the levels of detail, see getLod.
+     * 
+     * @return size_t Number of indices (0 if the model is not indexed).
+     */
+    [[nodiscard]] size_t getIndexCount() const
+    {
+        return geometry->indexCount();
+    }
+
+    /**
+     * @brief Get the indices of the model in the format used in the GPU (see getIndexType).
+     * 
+     * @param buffer Buffer used to store the indices if they must be converted to 16 bits.
+     * @return const void* Pointer to the indices.
+     */
+    const void *getIndexData(std::vector<GLushort> &buffer) const
+    {
+        return geometry->indexData(buffer);
+    }
+
+    /**
+     * @brief Get the minimum corner of the bounding box of the model (local coordinates).
+     * 
+     * @return const glm::vec3& Minimum corner of the bounding box.
+     */
+    [[nodiscard]] const glm::vec3 &getBoundsMin() const
+    {
+        return geometry->boundsMin;
+    }
+
+    /**
+     * @brief Get the maximum corner of the bounding box of the model (local coordinates).
+     * 
+     * @return const glm::vec3& Maximum corner of the bounding box.
+     */
+    [[nodiscard]] const glm::vec3 &getBoundsMax() const
+    {
+        return geometry->boundsMax;
+    }
+
+    /**
+     * @brief Get the radius of the bounding sphere of the model (local coordinates).
+     * 
+     * The sphere is centered in the bounding box.
+     * 
+     * @return float Radius of the bounding sphere.
+     */
+    [[nodiscard]] float getBoundsRadius() const
+    {
+        return geometry->boundsRadius;
+    }
+
+    /**
+     * @brief Get the type of the indices to use in the GPU.
+     * 
+     * Models with 65536 vertex or less use 16 bits indices, the rest use 32 bits indices.
+     * 
+     * @return GLenum GL_UNSIGNED_SHORT or GL_UNSIGNED_INT.
+     */
+    [[nodiscard]] GLenum getIndexType() const
+    {
+        return geometry->indexType();
     }
 
     /**
@@ -230,7 +884,7 @@ public:
      */
     [[nodiscard]] Shader *getShader() const
     {
-        return shader;
+        return shader.get();
     }
 
     /**
@@ -238,29 +892,66 @@ public:
      * 
      * Currently only accepts .obj files.
      * 
+     * The method does not use OpenGL, so it can be called from any thread (see Scene::addModelAsync).
+     * 
+     * If the file is already loaded by other model with the same options its geometry is
+     * shared (see GeometryRegistry), the file is not read again.
+     * 
      * @param filename Name of the file.
+     * @param options Options used to load the file.
+     * @return true If the file was loaded.
      */
-    void loadFile(std::string filename)
+    bool loadFile(std::string filename, const LoadOptions &options = LoadOptions())
     {
 
-        if (filename.substr(filename.find_last_of(".") + 1) == "obj")
+        std::string key = options.shareGeometry ? this->geometryKey(filename, options) : "";
+        if (!key.empty())
         {
-            this->load_obj(filename);
+            // the file is loaded (or being loaded by other thread), its result is used
+            std::shared_future<std::shared_ptr<Geometry>> pending;
+            if (!GeometryRegistry::shared().beginFile(key, pending))
+            {
+                std::shared_ptr<Geometry> loaded = pending.get();
+                if (loaded == nullptr)
+                    return false;
+
+                this->geometry = loaded;
+                return true;
+            }
         }
+
+        // the geometry of the file is built in a new object, the previous one can be shared
+        this->geometry = std::make_shared<Geometry>();
+        bool valid = filename.substr(filename.find_last_of(".") + 1) == "obj";
+        if (!valid)
+            this->error("Model could not be loaded. Incorrect format...");
         else
+            valid = this->load_obj(filename, options);
+
+        if (!valid)
         {
-            this->error("Model could not be loaded. Incorrect format...");
+            if (!key.empty())
+                GeometryRegistry::shared().cancelFile(key);
+            return false;
         }
+
+        if (!key.empty())
+            this->geometry = GeometryRegistry::shared().addFile(key, this->geometry);
+        return true;
     }
 
     /**
      * @brief Set the Shader object
      * 
+     * The model shares the ownership of the shader, it is deleted when no model (nor the
+     * caller, nor the shader it is a permutation of, see Shader::getVariant) uses it. The same
+     * shader can be given to several models.
+     * 
      * @param pShader Shader to be used in the model.
      */
-    void setShader(Shader *pShader)
+    void setShader(std::shared_ptr<Shader> pShader)
     {
-        this->shader = pShader;
+        this->shader = std::move(pShader);
     }
 
     /**
@@ -316,11 +1007,20 @@ public:
     /**
      * @brief Set the Colors object
      * 
+     * The colors are stored in the vertex of the model (only for models whose vertex are
+     * set with setVertex), there must be a color for each vertex.
+     * 
      * @param colors Vector with the colors of the vertex of the model.
      */
     void setColors(const std::vector<float> &colors)
     {
         Model::colors = colors;
+        if (geometry->cache.header == nullptr && geometry->layout.format == VERTEX_FORMAT_FLOAT)
+        {
+            this->editGeometry();
+            this->interleaveColors();
+            this->shareGeometry();
+        }
     }
 
     /**
@@ -363,6 +1063,17 @@ public:
         Model::name = name;
     }
 
+    /**
+     * @brief Method to give an information message
+     * 
+     * @param msg Message to show.
+     */
+    void info(std::string msg)
+    {
+        std::cout << "Info: "
+                  << "MODEL: " << msg << std::endl;
+    }
+
     /**
      * @brief Method to give an error message
      * 
@@ -0,0 +1,519 @@
+/**
+ * @file ObjParser.h
+ * @brief File with the parser used by the models to read .obj files.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * The parser works directly over the text of the file already loaded in memory. Lines and
+ * tokens are slices (std::string_view) of that buffer, so no string is created while the
+ * file is parsed, and the numbers are converted with std::from_chars.
+ *
+ * Big files are split in chunks at line boundaries that are parsed in parallel and then
+ * merged in a single ObjData.
+ */
+
+#ifndef RENDERENGINE_OBJPARSER_H
+#define RENDERENGINE_OBJPARSER_H
+
+#include <string_view>
+#include <charconv>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <ThreadPool.h>
+
+/**
+ * @brief Attributes that the corners of the faces can reference.
+ *
+ * The values are the position of the attribute in the index of the corners (the order
+ * used in the file: v/vt/vn).
+ */
+enum ObjAttribute
+{
+    OBJ_POSITION = 0,
+    OBJ_TEXCOORD = 1,
+    OBJ_NORMAL = 2
+};
+
+//! Number of floats of each attribute (positions xyz, texture coordinates uv, normals xyz)
+const size_t OBJ_ATTRIBUTE_SIZE[3] = {3, 2, 3};
+
+//! Index of the attributes that a corner does not reference
+const unsigned int OBJ_NONE = ~0u;
+
+/**
+ * @brief Corner of a triangle.
+ *
+ */
+struct ObjCorner
+{
+    //! Index (starting from 0) of the position, texture coordinate and normal, OBJ_NONE if the corner does not have it
+    unsigned int index[3];
+};
+
+/**
+ * @brief Geometry read from a .obj file.
+ *
+ * The faces are already triangulated (fan triangulation) and the indexes of the corners
+ * point to the arrays of attributes starting from 0.
+ */
+struct ObjData
+{
+    //! Values of the attributes (positions, texture coordinates and normals), indexed by ObjAttribute
+    std::vector<float> attributes[3];
+
+    //! Corners of the triangles (three per triangle)
+    std::vector<ObjCorner> triangles;
+
+    //! Number of faces (or triangles of faces) discarded because they were malformed
+    size_t invalidFaces = 0;
+
+    /**
+     * @brief Get the number of elements of an attribute.
+     *
+     * @param attribute Attribute to count.
+     * @return size_t Number of elements (not floats) of the attribute.
+     */
+    [[nodiscard]] size_t count(ObjAttribute attribute) const
+    {
+        return attributes[attribute].size() / OBJ_ATTRIBUTE_SIZE[attribute];
+    }
+};
+
+/**
+ * @brief Geometry read from a chunk of a .obj file.
+ *
+ * Relative indexes can not be resolved until the number of elements of the previous chunks
+ * is known, so they are stored relative to the start of the chunk and their positions in
+ * the triangles array are saved to be fixed in the merge.
+ */
+struct ObjChunk
+{
+    //! Corner of a triangle of the chunk (CHUNK_NONE if the corner does not reference the attribute)
+    struct Corner
+    {
+        // 32 bits keep the chunks small, files can not have more than 2^31 elements of each attribute
+        int32_t index[3];
+    };
+
+    //! Index of the attributes that a corner does not reference
+    static constexpr int32_t CHUNK_NONE = INT32_MIN;
+
+    //! Values of the attributes of the chunk, indexed by ObjAttribute
+    std::vector<float> attributes[3];
+
+    //! Corners of the triangles (three per triangle)
+    std::vector<Corner> triangles;
+
+    //! Positions in the triangles array of the corners with indexes relative to the chunk, for each attribute
+    std::vector<size_t> relative[3];
+
+    //! Number of faces that were discarded because they were malformed
+    size_t invalidFaces = 0;
+};
+
+/**
+ * @brief Parser of the text of .obj files.
+ *
+ * Currently reads the vertices (v), texture coordinates (vt), normals (vn) and the faces (f)
+ * of the file, the rest of the records are ignored. Faces with more than three corners are
+ * triangulated and the corners can use any of the formats v, v/vt, v//vn or v/vt/vn.
+ * Negative (relative) indexes are also supported.
+ */
+class ObjParser
+{
+public:
+    //! Minimum size (in bytes) of the chunks parsed in parallel
+    static constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+
+    /**
+     * @brief Parse the text of a .obj file.
+     *
+     * If the text is big enough it is split in chunks parsed by the shared ThreadPool.
+     *
+     * @param buffer Text of the file.
+     * @param data Structure where the geometry of the file is stored.
+     * @param threads Maximum number of threads used to parse the file (0 to use all the threads).
+     */
+    static void parse(std::string_view buffer, ObjData &data, unsigned int threads = 1)
+    {
+        ThreadPool &pool = ThreadPool::shared();
+        if (threads == 0)
+            threads = (unsigned int)pool.size() + 1;
+
+        // several chunks per thread to balance files with parts of different complexity
+        size_t chunkCount = std::min<size_t>((size_t)threads * 4, buffer.size() / MIN_CHUNK_SIZE);
+        if (threads == 1 || chunkCount <= 1)
+        {
+            std::vector<ObjChunk> chunks(1);
+            parseChunk(buffer, chunks[0]);
+            merge(chunks, data, 1);
+            return;
+        }
+
+        std::vector<std::string_view> texts = splitChunks(buffer, chunkCount);
+        std::vector<ObjChunk> chunks(texts.size());
+        pool.parallelFor(texts.size(), threads, [&texts, &chunks](size_t i) { parseChunk(texts[i], chunks[i]); });
+
+        merge(chunks, data, threads);
+    }
+
+    /**
+     * @brief Split the text in chunks of similar size that start at the beginning of a line.
+     *
+     * @param buffer Text of the file.
+     * @param count Number of chunks wanted (it can return less if the lines are too long).
+     * @return std::vector<std::string_view> Chunks of the text.
+     */
+    static std::vector<std::string_view> splitChunks(std::string_view buffer, size_t count)
+    {
+        std::vector<std::string_view> chunks;
+        size_t chunkSize = buffer.size() / std::max<size_t>(count, 1) + 1;
+
+        while (!buffer.empty())
+        {
+            size_t end = buffer.size() <= chunkSize ? std::string_view::npos : buffer.find('\n', chunkSize);
+            end = end == std::string_view::npos ? buffer.size() : end + 1;
+
+            chunks.push_back(buffer.substr(0, end));
+            buffer.remove_prefix(end);
+        }
+
+        return chunks;
+    }
+
+    /**
+     * @brief Parse a chunk of the text of a .obj file.
+     *
+     * The chunk must start at the beginning of a line.
+     *
+     * @param text Text of the chunk.
+     * @param chunk Structure where the geometry of the chunk is stored.
+     */
+    static void parseChunk(std::string_view text, ObjChunk &chunk)
+    {
+        // buffer used to store the corners of the face being parsed
+        std::vector<ObjChunk::Corner> face;
+        std::vector<unsigned char> faceRelative;
+
+        while (!text.empty())
+        {
+            std::string_view line = nextLine(text);
+            std::string_view keyword = nextToken(line);
+
+            if (keyword == "v")
+            {
+                parseValues(line, 3, chunk.attributes[OBJ_POSITION]);
+            }
+            else if (keyword == "vt")
+            {
+                // the third coordinate (w) is ignored
+                parseValues(line, 2, chunk.attributes[OBJ_TEXCOORD]);
+            }
+            else if (keyword == "vn")
+            {
+                parseValues(line, 3, chunk.attributes[OBJ_NORMAL]);
+            }
+            else if (keyword == "f")
+            {
+                face.clear();
+                faceRelative.clear();
+                if (parseFace(line, chunk, face, faceRelative))
+                    addFace(face, faceRelative, chunk);
+                else
+                    chunk.invalidFaces++;
+            }
+        }
+    }
+
+    /**
+     * @brief Merge the chunks of a file.
+     *
+     * The attributes of each chunk are placed after the ones of the previous chunks (prefix
+     * sum of the number of elements), which gives the offset used to resolve the relative
+     * indexes. Triangles that reference elements that do not exist are discarded.
+     *
+     * @param chunks Chunks of the file in order.
+     * @param data Structure where the geometry of the file is stored.
+     * @param threads Maximum number of threads used to merge the chunks.
+     */
+    static void merge(std::vector<ObjChunk> &chunks, ObjData &data, unsigned int threads)
+    {
+        // offsets (in floats) of each chunk in the final arrays
+        std::vector<size_t> attributeOffsets[3];
+        std::vector<size_t> triangleOffsets(chunks.size() + 1, 0);
+        for (int a = 0; a < 3; a++)
+        {
+            attributeOffsets[a].assign(chunks.size() + 1, data.attributes[a].size());
+            for (size_t i = 0; i < chunks.size(); i++)
+                attributeOffsets[a][i + 1] = attributeOffsets[a][i] + chunks[i].attributes[a].size();
+
+            data.attributes[a].resize(attributeOffsets[a].back());
+        }
+
+        triangleOffsets[0] = data.triangles.size();
+        for (size_t i = 0; i < chunks.size(); i++)
+        {
+            triangleOffsets[i + 1] = triangleOffsets[i] + chunks[i].triangles.size();
+            data.invalidFaces += chunks[i].invalidFaces;
+        }
+        data.triangles.resize(triangleOffsets.back());
+
+        long counts[3];
+        for (int a = 0; a < 3; a++)
+            counts[a] = (long)data.count((ObjAttribute)a);
+
+        std::vector<size_t> invalid(chunks.size(), 0);
+        auto mergeChunk = [&](size_t i) {
+            ObjChunk &chunk = chunks[i];
+
+            for (int a = 0; a < 3; a++)
+            {
+                std::copy(chunk.attributes[a].begin(), chunk.attributes[a].end(), data.attributes[a].begin() + attributeOffsets[a][i]);
+
+                long offset = (long)(attributeOffsets[a][i] / OBJ_ATTRIBUTE_SIZE[a]);
+                for (size_t position : chunk.relative[a])
+                    chunk.triangles[position].index[a] = (int32_t)(chunk.triangles[position].index[a] + offset);
+            }
+
+            ObjCorner *triangles = data.triangles.data() + triangleOffsets[i];
+            for (size_t t = 0; t < chunk.triangles.size(); t += 3)
+            {
+                bool valid = true;
+                for (size_t c = t; c < t + 3; c++)
+                {
+                    for (int a = 0; a < 3; a++)
+                    {
+                        long index = chunk.triangles[c].index[a];
+                        bool missing = index == ObjChunk::CHUNK_NONE && a != OBJ_POSITION;
+                        valid = valid && (missing || (index >= 0 && index < counts[a]));
+                        triangles[c].index[a] = missing ? OBJ_NONE : (unsigned int)index;
+                    }
+                }
+
+                // invalid triangles are marked to be removed after the merge
+                if (!valid)
+                {
+                    triangles[t].index[OBJ_POSITION] = OBJ_NONE;
+                    invalid[i]++;
+                }
+            }
+
+            // release the memory of the chunk as soon as possible
+            chunk = ObjChunk();
+        };
+
+        if (chunks.size() == 1)
+            mergeChunk(0);
+        else
+            ThreadPool::shared().parallelFor(chunks.size(), threads, mergeChunk);
+
+        size_t invalidTriangles = 0;
+        for (size_t count : invalid)
+            invalidTriangles += count;
+
+        if (invalidTriangles > 0)
+        {
+            size_t kept = triangleOffsets[0];
+            for (size_t t = triangleOffsets[0]; t < data.triangles.size(); t += 3)
+            {
+                if (data.triangles[t].index[OBJ_POSITION] == OBJ_NONE)
+                    continue;
+
+                data.triangles[kept++] = data.triangles[t];
+                data.triangles[kept++] = data.triangles[t + 1];
+                data.triangles[kept++] = data.triangles[t + 2];
+            }
+            data.triangles.resize(kept);
+            data.invalidFaces += invalidTriangles;
+        }
+    }
+
+    /**
+     * @brief Parse a float number.
+     *
+     * @param token Text with the number.
+     * @param value Variable where the number is stored.
+     * @return true If the token was a valid number.
+     */
+    static bool parseFloat(std::string_view token, float &value)
+    {
+        // from_chars does not accept the plus sign
+        if (!token.empty() && token[0] == '+')
+            token.remove_prefix(1);
+
+        std::from_chars_result result = std::from_chars(token.data(), token.data() + token.size(), value);
+        return result.ec == std::errc();
+    }
+
+    /**
+     * @brief Parse an integer number.
+     *
+     * @param token Text with the number.
+     * @param value Variable where the number is stored.
+     * @return true If the token was a valid number.
+     */
+    static bool parseInt(std::string_view token, long &value)
+    {
+        if (!token.empty() && token[0] == '+')
+            token.remove_prefix(1);
+
+        std::from_chars_result result = std::from_chars(token.data(), token.data() + token.size(), value);
+        return result.ec == std::errc();
+    }
+
+    /**
+     * @brief Get the next line of the buffer.
+     *
+     * The line is removed from the buffer and returned without the end of line characters.
+     *
+     * @param buffer Text to read the line from.
+     * @return std::string_view Line read.
+     */
+    static std::string_view nextLine(std::string_view &buffer)
+    {
+        size_t end = buffer.find('\n');
+        std::string_view line = buffer.substr(0, end);
+        buffer.remove_prefix(end == std::string_view::npos ? buffer.size() : end + 1);
+
+        // files saved in windows have \r\n as end of line
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        return line;
+    }
+
+    /**
+     * @brief Get the next token of the line (tokens are separated by spaces or tabs).
+     *
+     * The token is removed from the line. An empty token means that the line has ended.
+     *
+     * @param line Line to read the token from.
+     * @return std::string_view Token read.
+     */
+    static std::string_view nextToken(std::string_view &line)
+    {
+        size_t start = 0;
+        while (start < line.size() && (line[start] == ' ' || line[start] == '\t'))
+            start++;
+
+        size_t end = start;
+        while (end < line.size() && line[end] != ' ' && line[end] != '\t')
+            end++;
+
+        std::string_view token = line.substr(start, end - start);
+        line.remove_prefix(end);
+        return token;
+    }
+
+private:
+    /**
+     * @brief Parse the values of an attribute (v, vt or vn).
+     *
+     * Missing values are stored as 0.
+     *
+     * @param line Rest of the line (without the keyword).
+     * @param count Number of values of the attribute.
+     * @param values Vector where the values are added.
+     */
+    static void parseValues(std::string_view line, size_t count, std::vector<float> &values)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            float value = 0;
+            parseFloat(nextToken(line), value);
+            values.push_back(value);
+        }
+    }
+
+    /**
+     * @brief Read the indexes of the corners of a face.
+     *
+     * The indexes are stored starting from 0. Relative (negative) indexes are stored relative
+     * to the first element of the chunk using the number of elements read until the face.
+     *
+     * @param line Rest of the line of the face (without the f).
+     * @param chunk Chunk where the face is, used to resolve the relative indexes.
+     * @param face Vector where the corners are stored.
+     * @param faceRelative Vector where it is stored which indexes of each corner are relative (one bit per attribute).
+     * @return true If all the corners of the face are valid.
+     */
+    static bool parseFace(std::string_view line, const ObjChunk &chunk, std::vector<ObjChunk::Corner> &face,
+                          std::vector<unsigned char> &faceRelative)
+    {
+        for (std::string_view token = nextToken(line); !token.empty(); token = nextToken(line))
+        {
+            // faces can also have this format: f 6/4/1 3/5/3 7/6/5
+            ObjChunk::Corner corner = {{ObjChunk::CHUNK_NONE, ObjChunk::CHUNK_NONE, ObjChunk::CHUNK_NONE}};
+            unsigned char relative = 0;
+
+            const char *cursor = token.data();
+            const char *end = token.data() + token.size();
+            for (int a = 0; a < 3 && cursor < end; a++)
+            {
+                // the texture coordinate can be empty (v//vn), the position is mandatory
+                if (*cursor == '/')
+                {
+                    if (a == OBJ_POSITION)
+                        return false;
+                    cursor++;
+                    continue;
+                }
+
+                if (*cursor == '+')
+                    cursor++;
+
+                long index = 0;
+                std::from_chars_result result = std::from_chars(cursor, end, index);
+                if (result.ec != std::errc() || index == 0 || (result.ptr < end && *result.ptr != '/'))
+                    return false;
+                cursor = result.ptr < end ? result.ptr + 1 : end;
+
+                // indexes in the faces start from 1 and negative ones count from the last element
+                if (index > 0)
+                {
+                    corner.index[a] = (int32_t)(index - 1);
+                }
+                else
+                {
+                    corner.index[a] = (int32_t)((long)(chunk.attributes[a].size() / OBJ_ATTRIBUTE_SIZE[a]) + index);
+                    relative |= (unsigned char)(1 << a);
+                }
+            }
+
+            face.push_back(corner);
+            faceRelative.push_back(relative);
+        }
+
+        return face.size() >= 3;
+    }
+
+    /**
+     * @brief Triangulate a face and add it to the chunk.
+     *
+     * @param face Corners of the face.
+     * @param faceRelative Which indexes of each corner are relative to the chunk.
+     * @param chunk Structure where the triangles are added.
+     */
+    static void addFace(const std::vector<ObjChunk::Corner> &face, const std::vector<unsigned char> &faceRelative,
+                        ObjChunk &chunk)
+    {
+        for (size_t i = 1; i + 1 < face.size(); i++)
+        {
+            for (size_t corner : {(size_t)0, i, i + 1})
+            {
+                for (int a = 0; faceRelative[corner] != 0 && a < 3; a++)
+                {
+                    if (faceRelative[corner] & (1 << a))
+                        chunk.relative[a].push_back(chunk.triangles.size());
+                }
+
+                chunk.triangles.push_back(face[corner]);
+            }
+        }
+    }
+};
+
+#endif //RENDERENGINE_OBJPARSER_H
@@ -0,0 +1,444 @@
+/**
+ * @file ProgramCache.h
+ * @brief File with the binary cache (.rprog files) of the linked shader programs.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * Compiling and linking the GLSL of the shaders is the slowest part of the start of the
+ * engine. The first time that a program is linked its binary (glGetProgramBinary) is written
+ * in a .rprog file, the following runs give that binary to the driver (glProgramBinary) and
+ * do not compile the sources.
+ *
+ * The name of the file is the key of the program: a hash of the sources of all its stages
+ * (after the preprocessing, so the defines are part of them) and of the vendor, renderer and
+ * version of the driver, because the binaries are only valid for the driver that created them.
+ * The driver can still reject a binary (for example after an update that keeps the version
+ * string), in that case the file is removed and the program is compiled from the sources.
+ *
+ * Layout of a .rprog file:
+ *      - ProgramCacheHeader.
+ *      - Binary of the program (size bytes in the format binaryFormat).
+ */
+
+#ifndef RENDERENGINE_PROGRAMCACHE_H
+#define RENDERENGINE_PROGRAMCACHE_H
+
+#include <glad/glad.h>
+#include <MappedFile.h>
+#include <Utils.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#endif
+
+//! Version of the .rprog format, files with other version are ignored
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+/**
+ * @brief Header at the beginning of the .rprog files.
+ *
+ */
+struct ProgramCacheHeader
+{
+    //! Magic number of the format (RPRG)
+    char magic[4];
+
+    //! Version of the format
+    uint32_t version;
+
+    //! Key of the program (hash of the sources and of the driver)
+    uint64_t key;
+
+    //! Format of the binary given by glGetProgramBinary
+    uint32_t binaryFormat;
+
+    //! Reserved, always 0
+    uint32_t reserved;
+
+    //! Number of bytes of the binary
+    uint64_t size;
+
+    //! Hash of the binary (detects files that are corrupted)
+    uint64_t binaryHash;
+};
+
+static_assert(sizeof(ProgramCacheHeader) == 40, "ProgramCacheHeader must not have padding that changes between compilers");
+
+/**
+ * @brief Time spent building the shader programs since the start.
+ *
+ */
+struct ProgramCacheStatistics
+{
+    //! Programs loaded from the cache
+    size_t hits = 0;
+
+    //! Programs compiled from the sources
+    size_t compiled = 0;
+
+    //! Cache files rejected by the driver or corrupted (those programs were compiled)
+    size_t rejected = 0;
+
+    //! Milliseconds spent loading programs from the cache
+    double loadMilliseconds = 0;
+
+    //! Milliseconds spent compiling and linking programs (including the rejected loads)
+    double compileMilliseconds = 0;
+
+    //! Milliseconds spent writing the cache files
+    double storeMilliseconds = 0;
+};
+
+/**
+ * @brief Binary cache of the shader programs.
+ *
+ * The Shader uses it when the driver supports the program binaries (OpenGL 4.1 or
+ * GL_ARB_get_program_binary) and compiles the sources in other case. The engine uses a single
+ * cache (see ProgramCache::shared()), it must be used from the OpenGL thread.
+ */
+class ProgramCache
+{
+private:
+    //! Directory of the cache files
+    std::string directory = "./Shaders/cache";
+
+    //! If the cache is used (it can be disabled by the user)
+    bool enabled = true;
+
+    //! Hash of the vendor, renderer and version of the driver (0 until the first use)
+    uint64_t driverHash = 0;
+
+    //! If the driver can give and load program binaries (checked in the first use)
+    bool supported = false;
+
+    //! Statistics of the programs built
+    ProgramCacheStatistics statistics;
+
+    /**
+     * @brief Check the support of the driver and hash its strings, the first time.
+     *
+     * Must be called with the OpenGL context created.
+     */
+    void initDriver()
+    {
+        if (this->driverHash != 0)
+            return;
+
+        std::string driver;
+        const GLenum names[3] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+        for (GLenum name : names)
+        {
+            const GLubyte *value = glGetString(name);
+            driver += value != nullptr ? (const char *)value : "";
+            driver += '\n';
+        }
+        this->driverHash = hashBytes(driver.data(), driver.size()) | 1;
+
+        GLint formats = 0;
+        if (glGetProgramBinary != nullptr && glProgramBinary != nullptr && glProgramParameteri != nullptr)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        this->supported = formats > 0;
+    }
+
+    /**
+     * @brief Get the path of the cache file of a program.
+     *
+     * @param key Key of the program.
+     * @return std::string Path to the cache file.
+     */
+    std::string cachePath(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.rprog", (unsigned long long)key);
+        return this->directory + "/" + name;
+    }
+
+    /**
+     * @brief Create the directory of the cache if it does not exist.
+     *
+     */
+    void createDirectory() const
+    {
+#ifdef _WIN32
+        _mkdir(this->directory.c_str());
+#else
+        mkdir(this->directory.c_str(), 0755);
+#endif
+    }
+
+    /**
+     * @brief Milliseconds since a moment.
+     *
+     * @param start Moment to measure from.
+     * @return double Milliseconds elapsed.
+     */
+    static double elapsed(std::chrono::steady_clock::time_point start)
+    {
+        std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+        return time.count();
+    }
+
+public:
+    /**
+     * @brief Get the cache shared by the whole engine.
+     *
+     * @return ProgramCache& Cache of the engine.
+     */
+    static ProgramCache &shared()
+    {
+        static ProgramCache cache;
+        return cache;
+    }
+
+    /**
+     * @brief Get the key of a program.
+     *
+     * @param sources Sources of the stages of the program (in the same order each time, empty for the stages not used).
+     * @return uint64_t Key of the program.
+     */
+    uint64_t key(const std::vector<std::string> &sources)
+    {
+        this->initDriver();
+
+        uint64_t hash = this->driverHash;
+        for (const std::string &source : sources)
+        {
+            // the size is hashed too, so moving code between stages changes the key
+            uint64_t size = source.size();
+            hash = hashBytes(&size, sizeof(size), hash);
+            hash = hashBytes(source.data(), source.size(), hash);
+        }
+
+        return hash;
+    }
+
+    /**
+     * @brief Check if the programs can be loaded from the cache.
+     *
+     * @return true If the cache is enabled and the driver supports the program binaries.
+     */
+    bool isActive()
+    {
+        this->initDriver();
+        return this->enabled && this->supported;
+    }
+
+    /**
+     * @brief Load a program from its cache file.
+     *
+     * The program is linked with the binary of the file, if the driver rejects it (or the
+     * file is corrupted) the file is removed.
+     *
+     * @param program Program where the binary is loaded (created with glCreateProgram, without shaders).
+     * @param key Key of the program.
+     * @return true If the program is linked and can be used, if false it must be compiled from the sources.
+     */
+    bool load(GLuint program, uint64_t key)
+    {
+        if (!this->isActive())
+            return false;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::string path = this->cachePath(key);
+
+        MappedFile file;
+        if (!file.open(path, false) || file.size() < sizeof(ProgramCacheHeader))
+            return false;
+
+        ProgramCacheHeader header;
+        std::memcpy(&header, file.data(), sizeof(header));
+        const char *binary = file.data() + sizeof(header);
+        bool valid = std::memcmp(header.magic, "RPRG", 4) == 0 && header.version == PROGRAM_CACHE_VERSION && header.key == key &&
+                     header.size == file.size() - sizeof(header) && hashBytes(binary, header.size) == header.binaryHash;
+
+        GLint linked = 0;
+        if (valid)
+        {
+            glProgramBinary(program, header.binaryFormat, binary, (GLsizei)header.size);
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        }
+
+        if (linked == 0)
+        {
+            file.close();
+            std::remove(path.c_str());
+            this->statistics.rejected++;
+            this->statistics.compileMilliseconds += elapsed(start);
+            return false;
+        }
+
+        this->statistics.hits++;
+        this->statistics.loadMilliseconds += elapsed(start);
+        return true;
+    }
+
+    /**
+     * @brief Prepare a program to be stored in the cache, must be called before linking it.
+     *
+     * @param program Program that will be linked.
+     */
+    void prepare(GLuint program)
+    {
+        if (this->isActive())
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    /**
+     * @brief Write the cache file of a program linked from its sources.
+     *
+     * The file is written with a temporary name and renamed at the end, so a process reading
+     * the cache never sees a file half written.
+     *
+     * @param program Program linked (see prepare).
+     * @param key Key of the program.
+     * @return true If the file was written.
+     */
+    bool store(GLuint program, uint64_t key)
+    {
+        if (!this->isActive())
+            return false;
+
+        GLint linked = 0;
+        GLint length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (linked == 0 || length <= 0)
+            return false;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        std::vector<char> binary((size_t)length);
+        GLenum binaryFormat = 0;
+        GLsizei size = 0;
+        glGetProgramBinary(program, length, &size, &binaryFormat, binary.data());
+
+        ProgramCacheHeader header;
+        std::memcpy(header.magic, "RPRG", 4);
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        header.binaryFormat = binaryFormat;
+        header.reserved = 0;
+        header.size = (uint64_t)size;
+        header.binaryHash = hashBytes(binary.data(), (size_t)size);
+
+        this->createDirectory();
+        std::string path = this->cachePath(key);
+        std::string temporary = path + ".tmp";
+        bool written = false;
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (file)
+            {
+                file.write((const char *)&header, sizeof(header));
+                file.write(binary.data(), (std::streamsize)size);
+                written = (bool)file;
+            }
+        }
+
+        if (written)
+        {
+            // rename does not replace existing files in windows
+            std::remove(path.c_str());
+            written = std::rename(temporary.c_str(), path.c_str()) == 0;
+        }
+        if (!written)
+            std::remove(temporary.c_str());
+
+        this->statistics.storeMilliseconds += elapsed(start);
+        return written;
+    }
+
+    /**
+     * @brief Add the time of a program compiled from its sources to the statistics.
+     *
+     * @param milliseconds Time spent compiling and linking the program.
+     */
+    void countCompile(double milliseconds)
+    {
+        this->statistics.compiled++;
+        this->statistics.compileMilliseconds += milliseconds;
+    }
+
+    /**
+     * @brief Print the time spent building the programs (compile vs cache).
+     *
+     */
+    void printStatistics() const
+    {
+        const ProgramCacheStatistics &s = this->statistics;
+        char message[256];
+        std::snprintf(message, sizeof(message),
+                      "%zu programs compiled in %.2f ms, %zu loaded from the cache in %.2f ms (%zu rejected), %.2f ms writing the cache%s",
+                      s.compiled, s.compileMilliseconds, s.hits, s.loadMilliseconds, s.rejected, s.storeMilliseconds,
+                      this->supported ? "" : " (the driver does not support program binaries)");
+        std::cout << "Info: "
+                  << "PROGRAM CACHE: " << message << std::endl;
+    }
+
+    /***********************/
+    /* GETTERS AND SETTERS */
+    /***********************/
+
+    /**
+     * @brief Get the Statistics object
+     *
+     * @return const ProgramCacheStatistics& Time spent building the programs since the start.
+     */
+    [[nodiscard]] const ProgramCacheStatistics &getStatistics() const
+    {
+        return statistics;
+    }
+
+    /**
+     * @brief Get the Directory object
+     *
+     * @return const std::string& Directory of the cache files.
+     */
+    [[nodiscard]] const std::string &getDirectory() const
+    {
+        return directory;
+    }
+
+    /**
+     * @brief Set the Directory object
+     *
+     * @param path Directory of the cache files (created when the first file is written).
+     */
+    void setDirectory(const std::string &path)
+    {
+        this->directory = path;
+    }
+
+    /**
+     * @brief Get the Enabled object
+     *
+     * @return true If the programs are loaded from and stored in the cache.
+     */
+    [[nodiscard]] bool getEnabled() const
+    {
+        return enabled;
+    }
+
+    /**
+     * @brief Set the Enabled object
+     *
+     * @param value If false the programs are always compiled from the sources.
+     */
+    void setEnabled(bool value)
+    {
+        this->enabled = value;
+    }
+};
+
+#endif //RENDERENGINE_PROGRAMCACHE_H
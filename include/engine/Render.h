@@ -112,6 +112,8 @@ public:
         if (this->camera == nullptr)
             error("No se ha configurado una camara para el render");
 
+        // los modelos cargados en segundo plano se suben a la GPU antes de dibujar
+        this->scene->uploadPendingModels();
         this->scene->drawModels(this->WIDTH, this->HEIGHT, this->camera);
     }
 
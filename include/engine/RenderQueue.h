@@ -0,0 +1,281 @@
+/**
+ * @file RenderQueue.h
+ * @brief File with the queue that sorts the draws of a frame to reduce the changes of state.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * Each draw is encoded in a 64 bits key, so sorting the keys groups the draws that use the
+ * same shader and geometry (they are drawn without binding them again) and orders the draws
+ * of each group from the nearest to the farthest (the depth test rejects the hidden fragments
+ * before running the pixel shader).
+ *
+ * Bits of the key (from the most significant):
+ *      - Pass (2 bits), see RenderPass.
+ *      - Shader (12 bits).
+ *      - Geometry (16 bits).
+ *      - Level of detail (4 bits).
+ *      - Depth (30 bits), distance to the camera normalized to the far plane.
+ */
+
+#ifndef RENDERENGINE_RENDERQUEUE_H
+#define RENDERENGINE_RENDERQUEUE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Passes of the frame, they are drawn in this order.
+ *
+ */
+enum RenderPass
+{
+    //! Opaque geometry, drawn from front to back
+    RENDER_PASS_OPAQUE = 0,
+
+    //! Levels of detail in a dithered transition (each one with its own lodFade)
+    RENDER_PASS_DITHERED = 1
+};
+
+//! Number of bits of the depth in the sort key
+const int RENDER_KEY_DEPTH_BITS = 30;
+
+//! Number of bits of the level of detail in the sort key
+const int RENDER_KEY_LEVEL_BITS = 4;
+
+//! Number of bits of the geometry in the sort key
+const int RENDER_KEY_GEOMETRY_BITS = 16;
+
+//! Number of bits of the shader in the sort key
+const int RENDER_KEY_SHADER_BITS = 12;
+
+/**
+ * @brief Changes of state of the last frame submitted.
+ *
+ */
+struct RenderQueueStatistics
+{
+    //! Number of draws in the queue
+    size_t commands = 0;
+
+    //! Number of changes of shader, uniforms and geometry done
+    size_t stateChanges = 0;
+
+    //! Number of changes avoided (a bind of the shader, the uniforms and the geometry per draw minus the ones done)
+    size_t stateChangesSaved = 0;
+};
+
+/**
+ * @brief Queue of the draws of a frame sorted by their keys.
+ *
+ * The draws are pushed with their key and an index chosen by the user (for example the
+ * position in a vector of draws), after sort they are in the order they must be submitted.
+ */
+class RenderQueue
+{
+private:
+    //! Keys of the draws
+    std::vector<uint64_t> keys;
+
+    //! Index of each draw
+    std::vector<uint32_t> items;
+
+    //! Buffer of the keys used by the radix sort
+    std::vector<uint64_t> scratchKeys;
+
+    //! Buffer of the indexes used by the radix sort
+    std::vector<uint32_t> scratchItems;
+
+    //! Statistics of the last frame
+    RenderQueueStatistics statistics;
+
+public:
+    /**
+     * @brief Build the sort key of a draw.
+     *
+     * Only the lowest bits of the shader and geometry identifiers are used, two different
+     * objects can share them (the draws are still correct, only they are not grouped).
+     *
+     * @param pass Pass of the draw.
+     * @param shader Identifier of the shader (for example the name of the program).
+     * @param geometry Identifier of the geometry (for example the name of the VAO).
+     * @param level Level of detail (clamped to the levels that fit in the key).
+     * @param depth Distance to the camera, from 0 (camera) to 1 (far plane).
+     * @return uint64_t Sort key of the draw.
+     */
+    static uint64_t makeKey(RenderPass pass, uint32_t shader, uint32_t geometry, unsigned int level, float depth)
+    {
+        const uint64_t depthMax = (1ull << RENDER_KEY_DEPTH_BITS) - 1;
+        uint64_t quantizedDepth = (uint64_t)((double)std::min(std::max(depth, 0.0f), 1.0f) * (double)depthMax);
+        uint64_t quantizedLevel = std::min<uint64_t>(level, (1u << RENDER_KEY_LEVEL_BITS) - 1);
+
+        uint64_t key = (uint64_t)pass;
+        key = (key << RENDER_KEY_SHADER_BITS) | (shader & ((1u << RENDER_KEY_SHADER_BITS) - 1));
+        key = (key << RENDER_KEY_GEOMETRY_BITS) | (geometry & ((1u << RENDER_KEY_GEOMETRY_BITS) - 1));
+        key = (key << RENDER_KEY_LEVEL_BITS) | quantizedLevel;
+        return (key << RENDER_KEY_DEPTH_BITS) | quantizedDepth;
+    }
+
+    /**
+     * @brief Get the part of a key that identifies the state of the draw (all except the depth).
+     *
+     * @param key Sort key.
+     * @return uint64_t Pass, shader, geometry and level of the key.
+     */
+    static uint64_t stateOf(uint64_t key)
+    {
+        return key >> RENDER_KEY_DEPTH_BITS;
+    }
+
+    /**
+     * @brief Sort keys with their indexes (LSD radix sort, stable).
+     *
+     * The keys are sorted by bytes, the bytes that are equal in all the keys are skipped (the
+     * pass and the high bits of the identifiers are usually the same).
+     *
+     * @param keys Keys to sort.
+     * @param items Index of each key, moved with it.
+     * @param scratchKeys Buffer used to sort the keys.
+     * @param scratchItems Buffer used to sort the indexes.
+     */
+    static void radixSort(std::vector<uint64_t> &keys, std::vector<uint32_t> &items, std::vector<uint64_t> &scratchKeys,
+                          std::vector<uint32_t> &scratchItems)
+    {
+        size_t count = keys.size();
+        scratchKeys.resize(count);
+        scratchItems.resize(count);
+
+        // histograms of the 8 bytes in a single pass over the keys
+        size_t histograms[8][256] = {};
+        for (uint64_t key : keys)
+        {
+            for (int byte = 0; byte < 8; byte++)
+                histograms[byte][(key >> (8 * byte)) & 0xff]++;
+        }
+
+        for (int byte = 0; byte < 8; byte++)
+        {
+            size_t *histogram = histograms[byte];
+            if (count == 0 || histogram[(keys[0] >> (8 * byte)) & 0xff] == count)
+                continue;
+
+            // the histogram becomes the position of the first key of each bucket
+            size_t offset = 0;
+            for (int bucket = 0; bucket < 256; bucket++)
+            {
+                size_t size = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += size;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                size_t position = histogram[(keys[i] >> (8 * byte)) & 0xff]++;
+                scratchKeys[position] = keys[i];
+                scratchItems[position] = items[i];
+            }
+
+            keys.swap(scratchKeys);
+            items.swap(scratchItems);
+        }
+    }
+
+    /**
+     * @brief Remove all the draws (at the beginning of each frame).
+     *
+     */
+    void clear()
+    {
+        this->keys.clear();
+        this->items.clear();
+    }
+
+    /**
+     * @brief Add a draw to the queue.
+     *
+     * @param key Sort key of the draw (see makeKey).
+     * @param item Index of the draw.
+     */
+    void push(uint64_t key, uint32_t item)
+    {
+        this->keys.push_back(key);
+        this->items.push_back(item);
+    }
+
+    /**
+     * @brief Sort the draws by their keys.
+     *
+     */
+    void sort()
+    {
+        radixSort(this->keys, this->items, this->scratchKeys, this->scratchItems);
+        this->statistics = RenderQueueStatistics();
+        this->statistics.commands = this->keys.size();
+    }
+
+    /**
+     * @brief Get the number of draws in the queue.
+     *
+     * @return size_t Number of draws.
+     */
+    [[nodiscard]] size_t size() const
+    {
+        return keys.size();
+    }
+
+    /**
+     * @brief Get the key of a draw.
+     *
+     * @param position Position of the draw in the queue.
+     * @return uint64_t Sort key of the draw.
+     */
+    [[nodiscard]] uint64_t key(size_t position) const
+    {
+        return keys[position];
+    }
+
+    /**
+     * @brief Get the index of a draw.
+     *
+     * @param position Position of the draw in the queue.
+     * @return uint32_t Index given when the draw was pushed.
+     */
+    [[nodiscard]] uint32_t item(size_t position) const
+    {
+        return items[position];
+    }
+
+    /**
+     * @brief Count the changes of state done while submitting the queue.
+     *
+     * @param changes Number of changes (binds of shader, uniforms or geometry).
+     */
+    void countStateChanges(size_t changes)
+    {
+        this->statistics.stateChanges += changes;
+    }
+
+    /**
+     * @brief Finish the submission of the queue, calculating the changes of state saved.
+     *
+     * @param naiveChanges Changes of state that drawing each model alone would do.
+     */
+    void finish(size_t naiveChanges)
+    {
+        size_t done = this->statistics.stateChanges;
+        this->statistics.stateChangesSaved = naiveChanges > done ? naiveChanges - done : 0;
+    }
+
+    /**
+     * @brief Get the Statistics object
+     *
+     * @return const RenderQueueStatistics& Changes of state of the last frame submitted.
+     */
+    [[nodiscard]] const RenderQueueStatistics &getStatistics() const
+    {
+        return statistics;
+    }
+};
+
+#endif //RENDERENGINE_RENDERQUEUE_H
@@ -10,11 +10,84 @@
 #include <GLFW/glfw3.h>
 #include <Model.h>
 #include <Camera.h>
+#include <Frustum.h>
+#include <LodSelector.h>
+#include <RenderQueue.h>
+#include <FrameUniforms.h>
+#include <ComputeShader.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <Scene.h>
+#include <ThreadPool.h>
 #include <algorithm>
+#include <chrono>
+#include <future>
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+/**
+ * @brief Buffers of a geometry in the GPU, shared by all the models that use it.
+ * 
+ */
+struct GeometryBuffers
+{
+    //! VAO with the format of the vertex and the buffers
+    GLuint VAO;
+
+    //! Buffer with the vertex
+    GLuint VBO;
+
+    //! Buffer with the indices
+    GLuint EBO;
+
+    //! Number of models of the scene that use the buffers
+    size_t users;
+};
+
+/**
+ * @brief Model (or level of detail of a model) to draw in the current frame.
+ * 
+ * The instances with the same shader, geometry and level are drawn together with a single
+ * instanced draw call.
+ */
+struct DrawInstance
+{
+    //! Model to draw
+    Model *model;
+
+    //! Shader used to draw the model (the fallback shader while the one of the model is being built)
+    Shader *shader;
+
+    //! VAO of the geometry of the model
+    GLuint VAO;
+
+    //! Level of detail to draw
+    unsigned int level;
+
+    //! Value of lodFade, 1 except during a dithered transition (those instances are drawn alone)
+    float fade;
+
+    //! Model matrix (with the dequantization of the positions)
+    glm::mat4 matrix;
+};
+
+/**
+ * @brief Model that is being loaded in the background.
+ * 
+ */
+struct PendingModel
+{
+    //! Model being loaded
+    Model *model;
+
+    //! Result of the load of the file
+    std::future<bool> loaded;
+
+    //! Promise fulfilled when the model is added to the scene
+    std::promise<bool> added;
+};
 
 /**
  * @brief Class in charge of the scene of the render engine.
@@ -24,6 +97,9 @@
  * 
  * Use addModels to add models to the scene and drawModels to render them in
  * the screen (the render is the only one who should be doing this).
+ * 
+ * Models can also be loaded in background with addModelAsync, they are added to the
+ * scene by uploadPendingModels when their files are loaded.
  */
 class Scene
 {
@@ -38,8 +114,71 @@ private:
     //! Vector with the VBO object of the models.
     std::vector<GLuint> vectorVBO;
 
-    //! Vector with the VBO object storing the colors of the models.
-    std::vector<GLuint> vectorVBOC;
+    //! Vector with the EBO object storing the indices of the models.
+    std::vector<GLuint> vectorEBO;
+
+    //! Vector with the geometry of the models when they were added (keeps it alive while its buffers exist).
+    std::vector<std::shared_ptr<const Geometry>> vectorGeometry;
+
+    //! Buffers of each geometry in the GPU, the models with the same geometry use the same buffers.
+    std::unordered_map<const Geometry *, GeometryBuffers> geometryBuffers;
+
+    //! Models that are being loaded in background.
+    std::vector<PendingModel> pendingModels;
+
+    //! Maximum time (in milliseconds) used each frame to upload the pending models to the GPU.
+    double uploadBudget = 2.0;
+
+    //! Cull the back faces (in the GPU and the back-facing meshlets in the CPU).
+    bool backfaceCulling = false;
+
+    //! Selection of the level of detail of the models.
+    LodSelector lodSelector;
+
+    //! Bounds of the models in world coordinates, culled against the frustum each frame.
+    FrustumCuller frustumCuller;
+
+    //! Draws of the current frame sorted to reduce the changes of state.
+    RenderQueue renderQueue;
+
+    //! Instances to draw in the current frame (reused between frames).
+    std::vector<DrawInstance> instances;
+
+    //! Model matrices of the instances, in the order of the draw calls (reused between frames).
+    std::vector<glm::mat4> instanceMatrices;
+
+    //! Buffer with the model matrices of the instances (0 until the first frame).
+    GLuint instanceVBO = 0;
+
+    //! Size in bytes of the buffer of the instances.
+    size_t instanceCapacity = 0;
+
+    //! Buffer with the uniforms of the frame.
+    UniformBuffer<FrameUniforms> frameUniforms = UniformBuffer<FrameUniforms>(FRAME_BLOCK_BINDING);
+
+    //! Number of frames drawn.
+    uint32_t frameIndex = 0;
+
+    //! Time of the last frame drawn (seconds).
+    float frameTime = 0.0f;
+
+    //! Number of draw calls of the last frame.
+    size_t drawCalls = 0;
+
+    //! Number of meshlets drawn in the last frame.
+    size_t drawnMeshlets = 0;
+
+    //! Number of meshlets culled in the last frame.
+    size_t culledMeshlets = 0;
+
+    //! Number of indices of each range drawn by drawMeshlets (reused between frames).
+    std::vector<GLsizei> rangeCounts;
+
+    //! Offset in the index buffer of each range drawn by drawMeshlets (reused between frames).
+    std::vector<const void *> rangeOffsets;
+
+    //! Distance to the far plane of the camera
+    static constexpr float FAR_PLANE = 100.0f;
 
     //! Path to the pixel shader used to draw the axis
     const char *AXIS_VERTEX_SHADER = "./Shaders/Vertex_SimplePosAndColor.glsl";
@@ -47,6 +186,39 @@ private:
     //! Path to the fragment shader used to draw the axis
     const char *AXIS_FRAGMENT_SHADER = "./Shaders/Pixel_SimplePosAndColor.glsl";
 
+    //! Shader used to draw the models whose shader is being built (the one of the axis)
+    std::unique_ptr<Shader> fallbackShader;
+
+    //! Number of models drawn with the fallback shader in the current frame.
+    size_t fallbackDraws = 0;
+
+    //! If the statistics of the shader builds were printed (once all the programs drawn are ready).
+    bool shaderStatisticsPrinted = false;
+
+    /**
+     * @brief Get the shader used to draw a model in this frame.
+     * 
+     * The shaders built in background (see ShaderRegistry::setAsync) are replaced by the
+     * shader of the axis until they are ready, so the models are visible meanwhile.
+     * 
+     * @param m Model to draw.
+     * @return Shader* Shader of the model, or the fallback shader if it is not ready.
+     */
+    Shader *drawShader(Model *m)
+    {
+        if (m->getShader()->isReady())
+            return m->getShader();
+
+        this->fallbackDraws++;
+        if (this->fallbackShader == nullptr)
+        {
+            this->fallbackShader = std::make_unique<Shader>(this->AXIS_VERTEX_SHADER, this->AXIS_FRAGMENT_SHADER);
+            this->fallbackShader->wait();
+        }
+
+        return this->fallbackShader.get();
+    }
+
 public:
     /**
      * @brief Construct a new Scene object.
@@ -58,7 +230,7 @@ public:
         this->Models = std::vector<Model *>();
         this->vectorVAO = std::vector<GLuint>();
         this->vectorVBO = std::vector<GLuint>();
-        this->vectorVBOC = std::vector<GLuint>();
+        this->vectorEBO = std::vector<GLuint>();
     }
 
     /**
@@ -68,6 +240,13 @@ public:
     virtual ~Scene()
     {
 
+        // wait for the models being loaded, the workers are still using them
+        for (PendingModel &pending : this->pendingModels)
+        {
+            pending.loaded.wait();
+            delete pending.model;
+        }
+
         // delete all the models
         for (Model *m : this->Models)
         {
@@ -85,6 +264,12 @@ public:
      * Draw the models that are stored in the different buffers in the scene.
      * This method should be only used by the render of the engine.
      * 
+     * The models outside the frustum are discarded (see FrustumCuller). The rest are sorted by the render queue
+     * (shader, geometry, level of detail and depth, see RenderQueue) and each group with the
+     * same shader, geometry and level is drawn with a single instanced draw call (the model
+     * matrices of the instances are in a buffer, see VertexLayout::applyInstances). The shader
+     * and the VAO are only bound when they change.
+     * 
      * @param WIDTH width of the screen to calculate the aspect for the camera.
      * @param HEIGHT height of the screen to calculate the aspect of the camera.
      * @param camera Camera object to draw the elements in the scene.
@@ -92,37 +277,321 @@ public:
     void drawModels(int WIDTH, int HEIGHT, Camera *camera)
     {
 
-        // pass projection matrix to shader (note that in this case it could change every frame)
+        // projection matrix of the frame, given to the shaders in the frame uniforms (it could change every frame)
         glm::mat4 projection = glm::perspective(glm::radians(camera->Zoom), (float)WIDTH / (float)HEIGHT,
-                                                0.1f, 100.0f);
+                                                0.1f, FAR_PLANE);
+
+        // camera/view transformation
+        glm::mat4 view = camera->GetViewMatrix();
+        Frustum frustum = Frustum::fromMatrix(projection * view);
+        this->uploadFrameUniforms(projection, view, camera->Position, WIDTH, HEIGHT);
+
+        if (this->backfaceCulling)
+            glEnable(GL_CULL_FACE);
+        else
+            glDisable(GL_CULL_FACE);
+
+        this->drawnMeshlets = 0;
+        this->culledMeshlets = 0;
+        this->drawCalls = 0;
+        this->fallbackDraws = 0;
+
+        // the bounds of all the models are culled together (see FrustumCuller)
+        this->frustumCuller.resize(this->Models.size());
+        for (size_t i = 0; i < this->Models.size(); i++)
+        {
+            Model *m = this->Models[i];
+            this->frustumCuller.setBounds(i, m->getModelMatrix(), m->getBoundsMin(), m->getBoundsMax(), m->getBoundsRadius());
+        }
+        this->frustumCuller.cull(frustum);
 
         // se dibuja cada moedelo por separado
+        this->instances.clear();
+        this->renderQueue.clear();
         for (size_t i = 0; i < this->Models.size(); i++)
         {
 
             Model *m = this->Models.at(i);
 
-            if (m->getVertex().size() == 0)
+            if (m->getVertexCount() == 0)
                 error("Modelo de nombre " + m->getName() + " no tiene vertices");
 
-            // use the correct VAO
-            glBindVertexArray(this->vectorVAO.at(i));
+            if (!this->frustumCuller.isVisible(i))
+                continue;
+
+            // the quantized positions are restored by the model matrix
+            glm::vec3 center = this->frustumCuller.getCenter(i);
+            DrawInstance instance = {m, this->drawShader(m), this->vectorVAO.at(i), 0, 1.0f, m->getModelMatrix() * m->getDequantizationMatrix()};
+            float depth = glm::length(center - camera->Position) / FAR_PLANE;
+            if (m->getIndexCount() > 0)
+            {
+                // level of detail, during a dithered transition both levels are drawn with complementary pixels
+                LodSelection lod = this->lodSelector.select(i, m, camera->Position, glm::radians(camera->Zoom), HEIGHT);
+                instance.level = lod.level;
+                if (lod.fade < 1.0f)
+                {
+                    DrawInstance previous = instance;
+                    previous.level = lod.previous;
+                    previous.fade = -lod.fade;
+                    this->pushInstance(previous, RENDER_PASS_DITHERED, depth);
+                    instance.fade = lod.fade;
+                }
+            }
+            this->pushInstance(instance, instance.fade < 1.0f ? RENDER_PASS_DITHERED : RENDER_PASS_OPAQUE, depth);
+        }
+
+        // the instances of each group are consecutive, from the nearest to the farthest
+        this->renderQueue.sort();
+        this->uploadInstances();
+
+        // the buffer of the instances is not part of the state of the VAOs, it is bound once
+        glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+
+        // the buffers and textures written by compute shaders must be complete before the draws read them
+        MemoryBarriers::shared().wait(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_ELEMENT_ARRAY_BARRIER_BIT | GL_UNIFORM_BARRIER_BIT |
+                                      GL_TEXTURE_FETCH_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+        Shader *current = nullptr;
+        GLuint currentProgram = 0;
+        GLuint currentVAO = 0;
+        float currentFade = 1.0f;
+        size_t stateChanges = 0;
+        for (size_t first = 0; first < this->renderQueue.size();)
+        {
+            const DrawInstance &instance = this->instances[this->renderQueue.item(first)];
+            Model *m = instance.model;
+
+            // the instances in a transition are not grouped, each one has its own lodFade
+            size_t last = first + 1;
+            while (last < this->renderQueue.size() && instance.fade == 1.0f &&
+                   RenderQueue::stateOf(this->renderQueue.key(last)) == RenderQueue::stateOf(this->renderQueue.key(first)))
+            {
+                const DrawInstance &next = this->instances[this->renderQueue.item(last)];
+                if (next.fade != 1.0f || next.VAO != instance.VAO || next.shader != instance.shader ||
+                    next.model->getDrawType() != m->getDrawType())
+                    break;
+                last++;
+            }
+
+            // we use the shader (the shaders with the same sources share the program)
+            if (instance.shader != current)
+            {
+                current = instance.shader;
+                if (current->ID != currentProgram)
+                {
+                    currentProgram = current->ID;
+                    current->use();
+                    stateChanges++;
+                }
+                // without dithering it is 1, also in the shaders that were in a transition when it was disabled
+                currentFade = instance.fade;
+                current->setFloat("lodFade", currentFade);
+
+                // the uniforms are only available to the shader that is in use
+                // so we must update them in every change.
+                current->updateUniform();
+                stateChanges++;
+            }
+            else if (instance.fade != currentFade)
+            {
+                currentFade = instance.fade;
+                current->setFloat("lodFade", currentFade);
+                current->updateUniform();
+                stateChanges++;
+            }
 
-            // we use the shader
-            m->getShader()->use();
-            m->getShader()->setMat4("projection", projection);
+            // use the correct VAO, with the matrices of the group
+            if (instance.VAO != currentVAO)
+            {
+                currentVAO = instance.VAO;
+                glBindVertexArray(currentVAO);
+                stateChanges++;
+            }
+            VertexLayout::applyInstances(first * sizeof(glm::mat4));
 
-            // the uniforms are only available to the shader that is in use
-            // so we must update them in every change.
-            m->getShader()->updateUniform();
+            GLsizei count = (GLsizei)(last - first);
+            if (m->getIndexCount() == 0)
+            {
+                glDrawArraysInstanced(m->getDrawType(), 0, m->getVertexCount(), count);
+                this->drawCalls++;
+            }
+            else if (count == 1 && instance.level == 0 && !m->getMeshlets().empty())
+            {
+                // a single instance can cull its meshlets
+                this->drawMeshlets(m, projection * view * m->getModelMatrix(), camera->Position);
+            }
+            else
+            {
+                this->drawLod(m, instance.level, count);
+            }
 
-            // camera/view transformation
-            glm::mat4 view = camera->GetViewMatrix();
-            m->getShader()->setMat4("view", view);
+            first = last;
+        }
+
+        // drawing each model alone binds its shader, its uniforms and its VAO
+        this->renderQueue.countStateChanges(stateChanges);
+        this->renderQueue.finish(3 * this->instances.size());
 
-            // render boxes
-            m->getShader()->setMat4("model", m->getModelMatrix());
-            glDrawArrays(m->getDrawType(), 0, m->getVertex().size());
+        // in async mode the programs are only counted when they are ready, the statistics
+        // are printed in the first frame that draws every loaded model with its own shader
+        if (!this->shaderStatisticsPrinted && this->fallbackDraws == 0 && this->pendingModels.empty())
+        {
+            this->shaderStatisticsPrinted = true;
+            ProgramCache::shared().printStatistics();
+            ShaderRegistry::shared().printStatistics();
+        }
+    }
+
+    /**
+     * @brief Write the uniforms of the frame in their buffer (see FrameUniforms).
+     * 
+     * The buffer is bound to FRAME_BLOCK_BINDING, so all the shaders read the same values
+     * without setting them for each shader.
+     * 
+     * @param projection Projection matrix of the camera.
+     * @param view View matrix of the camera.
+     * @param cameraPosition Position of the camera.
+     * @param width Width of the screen in pixels.
+     * @param height Height of the screen in pixels.
+     */
+    void uploadFrameUniforms(const glm::mat4 &projection, const glm::mat4 &view, const glm::vec3 &cameraPosition, int width, int height)
+    {
+        float time = (float)glfwGetTime();
+
+        // only the values that changed are sent (a static camera only changes the time)
+        this->frameUniforms.set(&FrameUniforms::view, view);
+        this->frameUniforms.set(&FrameUniforms::projection, projection);
+        this->frameUniforms.set(&FrameUniforms::viewProjection, projection * view);
+        this->frameUniforms.set(&FrameUniforms::cameraPosition, glm::vec4(cameraPosition, 1.0f));
+        this->frameUniforms.set(&FrameUniforms::resolution, glm::vec3((float)width, (float)height, 1.0f));
+        this->frameUniforms.set(&FrameUniforms::time, time);
+        this->frameUniforms.set(&FrameUniforms::deltaTime, this->frameIndex > 0 ? time - this->frameTime : 0.0f);
+        this->frameUniforms.set(&FrameUniforms::frame, (int32_t)this->frameIndex);
+        this->frameTime = time;
+        this->frameIndex++;
+
+        this->frameUniforms.upload();
+        this->frameUniforms.bind();
+    }
+
+    /**
+     * @brief Add an instance to the draws of the frame.
+     * 
+     * @param instance Instance to draw.
+     * @param pass Pass where the instance is drawn.
+     * @param depth Distance of the instance to the camera relative to the far plane.
+     */
+    void pushInstance(const DrawInstance &instance, RenderPass pass, float depth)
+    {
+        // the names of the program and the VAO identify the shader and the geometry
+        uint64_t key = RenderQueue::makeKey(pass, instance.shader->ID, instance.VAO, instance.level, depth);
+        this->renderQueue.push(key, (uint32_t)this->instances.size());
+        this->instances.push_back(instance);
+    }
+
+    /**
+     * @brief Write the model matrices of the instances of the frame in the buffer of the instances.
+     * 
+     * The matrices are written in the order of the render queue, so the instances of each
+     * group are consecutive. The buffer grows when needed and it is orphaned every frame, so
+     * the GPU does not wait for the draws of the previous frame.
+     */
+    void uploadInstances()
+    {
+        this->instanceMatrices.clear();
+        for (size_t i = 0; i < this->renderQueue.size(); i++)
+            this->instanceMatrices.push_back(this->instances[this->renderQueue.item(i)].matrix);
+
+        if (this->instanceVBO == 0)
+            glGenBuffers(1, &this->instanceVBO);
+
+        size_t bytes = this->instanceMatrices.size() * sizeof(glm::mat4);
+        this->instanceCapacity = std::max(this->instanceCapacity, bytes);
+        glBindBuffer(GL_ARRAY_BUFFER, this->instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, this->instanceCapacity, nullptr, GL_STREAM_DRAW);
+        if (bytes > 0)
+            glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, this->instanceMatrices.data());
+    }
+
+    /**
+     * @brief Draw a level of detail of several instances of an indexed model.
+     * 
+     * The VAO, the shader and the matrices of the instances must be already in use.
+     * 
+     * @param m Model to draw.
+     * @param level Level of detail.
+     * @param instanceCount Number of instances.
+     */
+    void drawLod(Model *m, unsigned int level, GLsizei instanceCount)
+    {
+        MeshLod lod = m->getLod(level);
+        size_t indexSize = m->getIndexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+        glDrawElementsInstanced(m->getDrawType(), lod.indexCount, m->getIndexType(), (void *)(uintptr_t)(lod.indexOffset * indexSize),
+                                instanceCount);
+        this->drawCalls++;
+    }
+
+    /**
+     * @brief Draw the meshlets of a model that can be visible.
+     * 
+     * The meshlets outside the frustum (and the back-facing ones if the back faces are culled)
+     * are rejected, the rest are drawn with a single glMultiDrawElements joining the meshlets
+     * that are consecutive in the index buffer.
+     * 
+     * The VAO, the shader and the matrix of the instance must be already in use.
+     * 
+     * @param m Model to draw.
+     * @param modelViewProjection Matrix projection * view * model of the model.
+     * @param cameraPosition Position of the camera in world coordinates.
+     */
+    void drawMeshlets(Model *m, const glm::mat4 &modelViewProjection, const glm::vec3 &cameraPosition)
+    {
+        // the culling is done in model coordinates (the meshlets are not transformed)
+        Frustum frustum = Frustum::fromMatrix(modelViewProjection);
+        glm::vec3 eye = glm::vec3(glm::inverse(m->getModelMatrix()) * glm::vec4(cameraPosition, 1.0f));
+        size_t indexSize = m->getIndexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+
+        this->rangeCounts.clear();
+        this->rangeOffsets.clear();
+        uint32_t rangeEnd = 0;
+        for (const Meshlet &meshlet : m->getMeshlets())
+        {
+            glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+            bool visible = frustum.sphereVisible(center, meshlet.radius);
+
+            // all the triangles of the meshlet look away from the camera
+            if (visible && this->backfaceCulling)
+            {
+                glm::vec3 direction = center - eye;
+                glm::vec3 axis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+                visible = glm::dot(direction, axis) < meshlet.coneCutoff * glm::length(direction) + meshlet.radius;
+            }
+
+            if (!visible)
+            {
+                this->culledMeshlets++;
+                continue;
+            }
+            this->drawnMeshlets++;
+
+            GLsizei count = (GLsizei)(3 * meshlet.triangleCount);
+            if (!this->rangeCounts.empty() && rangeEnd == meshlet.indexOffset)
+            {
+                this->rangeCounts.back() += count;
+            }
+            else
+            {
+                this->rangeCounts.push_back(count);
+                this->rangeOffsets.push_back((const void *)(uintptr_t)(meshlet.indexOffset * indexSize));
+            }
+            rangeEnd = meshlet.indexOffset + (uint32_t)count;
+        }
+
+        if (!this->rangeCounts.empty())
+        {
+            glMultiDrawElements(m->getDrawType(), this->rangeCounts.data(), m->getIndexType(), this->rangeOffsets.data(),
+                                (GLsizei)this->rangeCounts.size());
+            this->drawCalls++;
         }
     }
 
@@ -132,6 +601,9 @@ public:
      * In case of modifying the objects (number of buffers to store data) this method should be changed
      * due that this is the method that draw them.
      * 
+     * If other model of the scene has the same geometry (see GeometryRegistry) its buffers are
+     * used, the geometry is uploaded only once.
+     * 
      * @param m Model to add to the scene.
      */
     void addModel(Model *m)
@@ -139,6 +611,18 @@ public:
 
         // add model at the end of the vector
         this->Models.push_back(m);
+        std::shared_ptr<const Geometry> geometry = m->getGeometry();
+        this->vectorGeometry.push_back(geometry);
+
+        std::unordered_map<const Geometry *, GeometryBuffers>::iterator shared = this->geometryBuffers.find(geometry.get());
+        if (shared != this->geometryBuffers.end())
+        {
+            shared->second.users++;
+            this->vectorVAO.push_back(shared->second.VAO);
+            this->vectorVBO.push_back(shared->second.VBO);
+            this->vectorEBO.push_back(shared->second.EBO);
+            return;
+        }
 
         /////////////////////////
         // GENERATE VAO AND VBO//
@@ -148,43 +632,109 @@ public:
         /* Esta parte se debe modificar si el tipo de los objetos cambia, se deben generar VAOs con la estructura
      * de los objetos.*/
 
-        GLuint VBOC, VBO, VAO;
+        GLuint VBO, VAO, EBO;
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
-        glGenBuffers(1, &VBOC);
+        glGenBuffers(1, &EBO);
 
         // add vao and vbo to the vectors
         // the vector stores copies, but the VAO and VBO variables are pointers, there isnt a problem
         // but probably that could generate bugs
         this->vectorVAO.push_back(VAO);
         this->vectorVBO.push_back(VBO);
-        this->vectorVBOC.push_back(VBOC);
+        this->vectorEBO.push_back(EBO);
+        this->geometryBuffers[geometry.get()] = {VAO, VBO, EBO, 1};
 
         glBindVertexArray(VAO);
 
-        // only enable position if the model have positions
-        if (!m->getVertex().empty())
+        // only enable the attributes if the model have vertex
+        if (m->getVertexCount() > 0)
         {
 
-            //  &m->getVertex()[0] entega un puntero al inicio de los elementos
+            // all the attributes are interleaved in a single buffer, getVertexData can point
+            // directly to the mapped binary cache of the model
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, m->getVertex().size() * sizeof(float), &m->getVertex()[0], GL_STATIC_DRAW);
+            glBufferData(GL_ARRAY_BUFFER, m->getVertexCount() * m->getLayout().stride, m->getVertexData(), GL_STATIC_DRAW);
+
+            // position, color, normal and texture coordinate attributes (the ones the model has)
+            m->getLayout().apply();
+        }
 
-            // position attribute
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
-            glEnableVertexAttribArray(0);
+        // only use the index buffer if the model is indexed (the VAO stores the binding)
+        if (m->getIndexCount() > 0)
+        {
+
+            // models small enough use 16 bits indices (half of the memory)
+            std::vector<GLushort> buffer;
+            size_t indexSize = m->getIndexType() == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, m->getIndexCount() * indexSize, m->getIndexData(buffer), GL_STATIC_DRAW);
         }
+    }
+
+    /**
+     * @brief Load the file of a model in background and add it to the scene when loaded.
+     * 
+     * The file is read and parsed by the shared ThreadPool. Only the creation of the buffers
+     * is done in the OpenGL thread by uploadPendingModels, so the render loop keeps running
+     * while the model is loaded. The model must not be modified until the future is ready,
+     * only its shader, position and rotation can be changed.
+     * 
+     * @param m Model to load and add to the scene.
+     * @param filename Name of the file of the model.
+     * @param options Options used to load the file.
+     * @return std::future<bool> Future that is ready when the model is added to the scene
+     * (false if the file could not be loaded, in that case the model is not added and it is not deleted by the scene).
+     */
+    std::future<bool> addModelAsync(Model *m, const std::string &filename, const LoadOptions &options = LoadOptions())
+    {
+
+        PendingModel pending;
+        pending.model = m;
+        pending.loaded = ThreadPool::shared().submit([m, filename, options]() { return m->loadFile(filename, options); });
+
+        std::future<bool> added = pending.added.get_future();
+        this->pendingModels.push_back(std::move(pending));
+
+        return added;
+    }
+
+    /**
+     * @brief Add to the scene the models loaded in background.
+     * 
+     * Create the buffers of the pending models whose files are already loaded, until the
+     * upload time budget of the frame is consumed (at least one model is uploaded each
+     * frame). Must be called from the OpenGL thread, the render calls it every frame.
+     */
+    void uploadPendingModels()
+    {
 
-        // only enable color atribute if the model has the array
-        if (!m->getColors().empty())
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (size_t i = 0; i < this->pendingModels.size();)
         {
+            PendingModel &pending = this->pendingModels[i];
+            if (pending.loaded.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            {
+                i++;
+                continue;
+            }
 
-            // color attribute
-            glBindBuffer(GL_ARRAY_BUFFER, VBOC);
-            glBufferData(GL_ARRAY_BUFFER, m->getColors().size() * sizeof(float), &m->getColors()[0], GL_STATIC_DRAW);
+            if (pending.loaded.get())
+            {
+                this->addModel(pending.model);
+                pending.added.set_value(true);
+            }
+            else
+            {
+                error("Modelo de nombre " + pending.model->getName() + " no se pudo cargar");
+                pending.added.set_value(false);
+            }
+            this->pendingModels.erase(this->pendingModels.begin() + i);
 
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void *)0);
-            glEnableVertexAttribArray(1);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= this->uploadBudget)
+                break;
         }
     }
 
@@ -192,6 +742,171 @@ public:
     /* GETTERS AND SETTERS */
     /***********************/
 
+    /**
+     * @brief Get the Upload Budget object
+     * 
+     * @return double Maximum time (in milliseconds) used each frame to upload the pending models.
+     */
+    double getUploadBudget() const
+    {
+        return uploadBudget;
+    }
+
+    /**
+     * @brief Set the Upload Budget object
+     * 
+     * @param milliseconds Maximum time (in milliseconds) used each frame to upload the pending models.
+     */
+    void setUploadBudget(double milliseconds)
+    {
+        this->uploadBudget = milliseconds;
+    }
+
+    /**
+     * @brief Get the Backface Culling object
+     * 
+     * @return true If the back faces are culled.
+     */
+    bool getBackfaceCulling() const
+    {
+        return backfaceCulling;
+    }
+
+    /**
+     * @brief Set the Backface Culling object
+     * 
+     * The models must have their triangles in counter-clockwise order, in other case they
+     * are not drawn.
+     * 
+     * @param cull If true the back faces are culled (and the meshlets that only have back faces).
+     */
+    void setBackfaceCulling(bool cull)
+    {
+        this->backfaceCulling = cull;
+    }
+
+    /**
+     * @brief Get the Lod Selector object
+     * 
+     * Use it to configure the selection of the levels of detail (pixel error, bias, hysteresis
+     * and dithering).
+     * 
+     * @return LodSelector& Selector of the levels of detail of the scene.
+     */
+    LodSelector &getLodSelector()
+    {
+        return lodSelector;
+    }
+
+    /**
+     * @brief Get the number of draw calls of the last frame.
+     * 
+     * The models with the same shader, geometry and level of detail are drawn with a single
+     * instanced draw call.
+     * 
+     * @return size_t Number of draw calls.
+     */
+    size_t getDrawCallCount() const
+    {
+        return drawCalls;
+    }
+
+    /**
+     * @brief Get the statistics of the render queue of the last frame.
+     * 
+     * @return const RenderQueueStatistics& Number of draws and changes of state done and saved.
+     */
+    const RenderQueueStatistics &getRenderStatistics() const
+    {
+        return renderQueue.getStatistics();
+    }
+
+    /**
+     * @brief Get the number of models inside the frustum in the last frame.
+     * 
+     * @return size_t Number of models not culled.
+     */
+    size_t getVisibleModelCount() const
+    {
+        return frustumCuller.getStatistics().visible;
+    }
+
+    /**
+     * @brief Get the number of models outside the frustum in the last frame.
+     * 
+     * @return size_t Number of models culled.
+     */
+    size_t getCulledModelCount() const
+    {
+        return frustumCuller.getStatistics().culled;
+    }
+
+    /**
+     * @brief Get the statistics of the frustum culling of the models in the last frame.
+     * 
+     * @return const CullingStatistics& Number of models visible and culled, and how many were rejected by their last plane.
+     */
+    const CullingStatistics &getCullingStatistics() const
+    {
+        return frustumCuller.getStatistics();
+    }
+
+    /**
+     * @brief Get the number of meshlets drawn in the last frame.
+     * 
+     * @return size_t Number of meshlets drawn.
+     */
+    size_t getDrawnMeshletCount() const
+    {
+        return drawnMeshlets;
+    }
+
+    /**
+     * @brief Get the number of meshlets culled in the last frame.
+     * 
+     * @return size_t Number of meshlets rejected by the frustum or back-face culling.
+     */
+    size_t getCulledMeshletCount() const
+    {
+        return culledMeshlets;
+    }
+
+    /**
+     * @brief Get the number of geometries in the GPU.
+     * 
+     * The models that share the geometry use the same buffers, so it can be less than the
+     * number of models.
+     * 
+     * @return size_t Number of geometries uploaded.
+     */
+    size_t getGeometryCount() const
+    {
+        return geometryBuffers.size();
+    }
+
+    /**
+     * @brief Get the memory used by the geometry of the models in the GPU.
+     * 
+     * @return size_t Bytes of the vertex and index buffers (each shared geometry is counted once).
+     */
+    size_t getGeometryMemory() const
+    {
+        size_t bytes = 0;
+        for (const std::pair<const Geometry *const, GeometryBuffers> &buffers : this->geometryBuffers)
+            bytes += buffers.first->gpuBytes();
+        return bytes;
+    }
+
+    /**
+     * @brief Get the number of models that are being loaded in background.
+     * 
+     * @return size_t Number of pending models.
+     */
+    size_t getPendingModelCount() const
+    {
+        return pendingModels.size();
+    }
+
     /*********
      * UTILS *
      *********/
@@ -220,13 +935,28 @@ public:
         if (index == -1)
         {
             error("Se intento borrar un modelo que no se encuentra en el arreglo");
+            return;
+        }
+
+        // the buffers are deleted when the last model that uses them is removed
+        std::unordered_map<const Geometry *, GeometryBuffers>::iterator buffers =
+            this->geometryBuffers.find(this->vectorGeometry[index].get());
+        if (buffers != this->geometryBuffers.end() && --buffers->second.users == 0)
+        {
+            glDeleteVertexArrays(1, &buffers->second.VAO);
+            glDeleteBuffers(1, &buffers->second.VBO);
+            glDeleteBuffers(1, &buffers->second.EBO);
+            this->geometryBuffers.erase(buffers);
         }
 
         // delete the elements in the array
         this->Models.erase(this->Models.begin() + index);
-        this->vectorVBOC.erase(this->vectorVBOC.begin() + index);
+        this->vectorGeometry.erase(this->vectorGeometry.begin() + index);
+        this->vectorEBO.erase(this->vectorEBO.begin() + index);
         this->vectorVBO.erase(this->vectorVBO.begin() + index);
         this->vectorVAO.erase(this->vectorVAO.begin() + index);
+        this->lodSelector.remove(index);
+        this->frustumCuller.remove(index);
     }
 
     /**
@@ -243,7 +973,7 @@ public:
         Model *zAxis = new Model();
 
         // create and set shader
-        Shader *shader = new Shader(this->AXIS_VERTEX_SHADER, this->AXIS_FRAGMENT_SHADER);
+        std::shared_ptr<Shader> shader = std::make_shared<Shader>(this->AXIS_VERTEX_SHADER, this->AXIS_FRAGMENT_SHADER);
         xAxis->setShader(shader);
         yAxis->setShader(shader);
         zAxis->setShader(shader);
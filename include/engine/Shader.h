@@ -3,13 +3,27 @@
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
+#include <FrameUniforms.h>
+#include <ProgramCache.h>
+#include <ShaderPreprocessor.h>
 
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <iterator>
 #include <map>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GL_COMPLETION_STATUS_KHR
+//! Query of GL_KHR_parallel_shader_compile, true when the compilation or the link finished
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 /**
  * @brief Enum to indetify the types of the Uniforms for the shaders.
@@ -29,31 +43,238 @@ enum dataType
 };
 
 /**
- * @brief Store all the information of an uniform in the shader.
+ * @brief Active uniform of a shader program.
  * 
  */
-struct UniformData
+struct ShaderUniform
 {
-    //! Boolean uniform data
-    bool UD_boolean;
-    //! Integer uniform data
-    int UD_integer;
-    //! float uniform data
-    float UD_float;
-    //! two dimensional vector uniform data
-    glm::vec2 UD_vec2;
-    //! three dimensional vector uniform data
-    glm::vec3 UD_vec3;
-    //! four dimensional vector uniform data
-    glm::vec4 UD_vec4;
-    //! 2x2 matrix uniform data
-    glm::mat2 UD_mat2;
-    //! 3x3 matrix uniform data
-    glm::mat3 UD_mat3;
-    //! 4x4 matrix uniform data
-    glm::mat4 UD_mat4;
-    //! type of the data stored in the struct (all other are null)
-    dataType myType;
+    //! Name of the uniform (without [0] for the arrays)
+    std::string name;
+
+    //! Location of the uniform in the program
+    GLint location;
+
+    //! Type of the uniform
+    dataType type;
+
+    //! Position of the value of the uniform in the values of the shader
+    size_t offset;
+
+    //! Number of 4 bytes words of the value
+    size_t words;
+};
+
+/**
+ * @brief Linked program shared by the shaders built from the same sources.
+ * 
+ * The program only has what depends on the sources (the OpenGL object and its uniforms),
+ * the values of the uniforms are kept by each Shader, so the shaders that share a program
+ * can have different values (the one in use uploads its values when it is updated).
+ */
+struct ShaderProgram
+{
+    //! ID of the OpenGL program
+    unsigned int ID = 0;
+
+    //! Sources of the stages (vertex, fragment, geometry and compute)
+    std::vector<std::string> sources;
+
+    //! Active uniforms of the program, the position in the vector is the handle of the uniform
+    std::vector<ShaderUniform> uniforms;
+
+    //! Handle of each uniform by name
+    std::unordered_map<std::string, int> handles;
+
+    //! Values of the uniforms after linking (the initial values of the shaders)
+    std::vector<float> defaults;
+
+    //! Values of the uniforms that are in the OpenGL program now
+    std::vector<float> current;
+
+    //! Shader whose values are in the program (nullptr if they are from several shaders)
+    const void *owner = nullptr;
+
+    //! False while the program is being compiled in background (see ShaderRegistry::setAsync)
+    bool ready = true;
+
+    //! Shaders of the stages submitted and not checked yet, with the name of their stage
+    std::vector<std::pair<GLuint, std::string>> pendingStages;
+
+    //! Key of the sources, to store the program in the binary cache when it is linked
+    uint64_t key = 0;
+
+    //! Milliseconds that the OpenGL thread spent submitting the program
+    double submitMilliseconds = 0;
+
+    ShaderProgram() = default;
+    ShaderProgram(const ShaderProgram &) = delete;
+    ShaderProgram &operator=(const ShaderProgram &) = delete;
+
+    /**
+     * @brief Destroy the Shader Program object, deleting the OpenGL program.
+     * 
+     */
+    ~ShaderProgram()
+    {
+        for (const std::pair<GLuint, std::string> &stage : pendingStages)
+            glDeleteShader(stage.first);
+        if (ID != 0)
+            glDeleteProgram(ID);
+    }
+};
+
+/**
+ * @brief Registry of the programs used by the shaders.
+ * 
+ * The programs are found by the key of their sources (see ProgramCache::key), so creating a
+ * shader with the same files again does not compile nor link them. The registry does not keep
+ * the programs alive, they are deleted when the last shader that uses them is destroyed.
+ * 
+ * The engine uses a single registry (see ShaderRegistry::shared()), it must be used from the
+ * OpenGL thread.
+ */
+class ShaderRegistry
+{
+private:
+    //! Programs by key of their sources
+    std::unordered_map<uint64_t, std::weak_ptr<ShaderProgram>> programs;
+
+    //! Number of shaders created
+    size_t requests = 0;
+
+    //! Number of shaders that used a program already linked
+    size_t hits = 0;
+
+    //! If the new programs are built in background
+    bool async = false;
+
+    //! If the driver has GL_KHR_parallel_shader_compile (-1 until it is checked)
+    int parallelCompile = -1;
+
+public:
+    /**
+     * @brief Get the registry shared by the whole engine.
+     * 
+     * @return ShaderRegistry& Registry of the engine.
+     */
+    static ShaderRegistry &shared()
+    {
+        static ShaderRegistry registry;
+        return registry;
+    }
+
+    /**
+     * @brief Find the program linked from some sources.
+     * 
+     * @param key Key of the sources.
+     * @param sources Sources of the stages (compared to discard the collisions of the key).
+     * @return std::shared_ptr<ShaderProgram> Program of the sources (nullptr if it is not linked).
+     */
+    std::shared_ptr<ShaderProgram> find(uint64_t key, const std::vector<std::string> &sources)
+    {
+        this->requests++;
+        auto it = this->programs.find(key);
+        if (it == this->programs.end())
+            return nullptr;
+
+        std::shared_ptr<ShaderProgram> program = it->second.lock();
+        if (program == nullptr || program->sources != sources)
+            return nullptr;
+
+        this->hits++;
+        return program;
+    }
+
+    /**
+     * @brief Register a program linked from its sources.
+     * 
+     * @param key Key of the sources of the program.
+     * @param program Program linked.
+     */
+    void add(uint64_t key, const std::shared_ptr<ShaderProgram> &program)
+    {
+        // the expired entries are removed here, the programs are created few times
+        for (auto it = this->programs.begin(); it != this->programs.end();)
+            it = it->second.expired() ? this->programs.erase(it) : std::next(it);
+
+        std::weak_ptr<ShaderProgram> &entry = this->programs[key];
+        if (entry.expired())
+            entry = program;
+    }
+
+    /**
+     * @brief Get the number of programs that are being used.
+     * 
+     * @return size_t Number of programs alive.
+     */
+    [[nodiscard]] size_t size() const
+    {
+        size_t count = 0;
+        for (const auto &entry : this->programs)
+            count += entry.second.expired() ? 0 : 1;
+        return count;
+    }
+
+    /**
+     * @brief Check if the driver can be asked whether a program finished without waiting for it.
+     * 
+     * @return true If the driver has GL_KHR_parallel_shader_compile (or GL_ARB_parallel_shader_compile).
+     */
+    bool hasParallelCompile()
+    {
+        if (this->parallelCompile >= 0)
+            return this->parallelCompile == 1;
+
+        this->parallelCompile = 0;
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            const char *name = (const char *)glGetStringi(GL_EXTENSIONS, (GLuint)i);
+            if (name != nullptr && (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0 ||
+                                    std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0))
+                this->parallelCompile = 1;
+        }
+
+        return this->parallelCompile == 1;
+    }
+
+    /**
+     * @brief Get the Async object
+     * 
+     * @return true If the new programs are built in background.
+     */
+    [[nodiscard]] bool getAsync() const
+    {
+        return async;
+    }
+
+    /**
+     * @brief Set the Async object
+     * 
+     * In async mode the shaders only submit their sources to the driver, the compilation
+     * and the link are checked when the shader is used (see Shader::isReady). Creating all
+     * the shaders of the scene before using them lets the driver compile them in parallel
+     * while the models are loaded, the Scene draws the models with a fallback shader until
+     * their shader is ready.
+     * 
+     * @param value If the new programs are built in background.
+     */
+    void setAsync(bool value)
+    {
+        this->async = value;
+    }
+
+    /**
+     * @brief Print the number of shaders created and of programs linked for them.
+     * 
+     */
+    void printStatistics() const
+    {
+        std::cout << "Info: "
+                  << "SHADER REGISTRY: " << this->requests << " shaders created, " << this->hits
+                  << " of them reused a program, " << this->size() << " programs in use" << std::endl;
+    }
 };
 
 /**
@@ -61,152 +282,174 @@ struct UniformData
  * 
  * Class contains all the methods to add uniforms to the shaders and to compile them in the render process.
  * 
- * Currently accept four shaders: Pixel, Fragment, Geometry and Compute shaders.
+ * Accepts the vertex, fragment and geometry stages, the programs with only a compute stage
+ * must use ComputeShader (see ComputeShader.h).
+ * 
+ * The shaders built from the same files share the OpenGL program (see ShaderRegistry), each
+ * one keeps its own values of the uniforms, so they can be used as different materials.
+ * 
+ * The shaders are owned with std::shared_ptr (the models that use a shader share it, see
+ * Model::setShader), create them with std::make_shared.
  * 
  */
-class Shader
+class Shader : public std::enable_shared_from_this<Shader>
 {
 public:
     //! ID of the shader program
     unsigned int ID;
 
-    //! Map of uniforms in the shader
-    std::map<std::string, UniformData> myUniforms;
+    //! Program of the shader, shared with the shaders built from the same sources
+    std::shared_ptr<ShaderProgram> program;
+
+    //! Values of the uniforms (floats, the integers are stored with their bits)
+    std::vector<float> values;
+
+    //! Handles of the uniforms that changed since the last upload
+    std::vector<int> dirtyUniforms;
+
+    //! If each uniform is in dirtyUniforms
+    std::vector<char> dirty;
+
+    //! True when the program is linked and the shader has its uniforms
+    bool ready = false;
+
+    //! Names of the uniforms asked while the program was being built (their handles are -2, -3...)
+    mutable std::vector<std::string> pendingNames;
+
+    //! Values set while the program was being built (handle in pendingNames, type and value)
+    std::vector<std::pair<int, std::pair<dataType, std::vector<float>>>> pendingValues;
+
+    //! Paths to the code of the stages (empty for the stages not used)
+    std::string paths[4];
+
+    //! Defines of the permutation of the shader
+    ShaderDefines defines;
+
+    //! Permutations of the shader created by getVariant (the same files with other defines)
+    std::map<ShaderDefines, std::shared_ptr<Shader>> variants;
 
     /**
      * @brief Construct a new Shader object
      * 
+     * The files are preprocessed (see ShaderPreprocessor), the defines are added to all the
+     * stages, so each set of defines is a different permutation of the shader.
+     * 
      * @param vertexPath Path to the code of the vertex shader.
      * @param fragmentPath Path to the code of the fragment shader.
      * @param geometryPath Path to the code of the geometry shader.
-     * @param computePath Path to the code of the compute shader.
+     * @param computePath Path to the code of the compute shader (only without the other stages, see ComputeShader).
+     * @param shaderDefines Defines added to the code of the stages.
      */
     Shader(const char *vertexPath, const char *fragmentPath, const char *geometryPath = nullptr,
-           const char *computePath = nullptr)
-    {
-
-        // 0. initialize variables
-        myUniforms = std::map<std::string, UniformData>();
-
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::string geometryCode;
-        std::string computeCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
-        std::ifstream gShaderFile;
-        std::ifstream cShaderFile;
-        // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        gShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        cShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        try
-        {
-            // if vertex shader path is present, load a vertex shader
-            if (vertexPath != nullptr)
-            {
-                vShaderFile.open(vertexPath);
-                std::stringstream vShaderStream;
-                vShaderStream << vShaderFile.rdbuf();
-                vShaderFile.close();
-                vertexCode = vShaderStream.str();
-            }
-            // if fragment shader path is present, also load a fragment shader
-            if (fragmentPath != nullptr)
-            {
-                fShaderFile.open(fragmentPath);
-                std::stringstream fShaderStream;
-                fShaderStream << fShaderFile.rdbuf();
-                fShaderFile.close();
-                fragmentCode = fShaderStream.str();
-            }
-            // if geometry shader path is present, also load a geometry shader
-            if (geometryPath != nullptr)
-            {
-                gShaderFile.open(geometryPath);
-                std::stringstream gShaderStream;
-                gShaderStream << gShaderFile.rdbuf();
-                gShaderFile.close();
-                geometryCode = gShaderStream.str();
-            }
-            // if compute shader path is present, also load a compute shader
-            if (computePath != nullptr)
-            {
-                cShaderFile.open(computePath);
-                std::stringstream cShaderStream;
-                cShaderStream << cShaderFile.rdbuf();
-                cShaderFile.close();
-                computeCode = cShaderStream.str();
-            }
-        }
-        catch (std::ifstream::failure e)
+           const char *computePath = nullptr, const ShaderDefines &shaderDefines = ShaderDefines())
+        : defines(shaderDefines)
+    {
+
+        // a program can not have the compute stage and the graphic stages (it would not link)
+        if (computePath != nullptr && (vertexPath != nullptr || fragmentPath != nullptr || geometryPath != nullptr))
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+            std::cout << "ERROR::SHADER::COMPUTE_WITH_GRAPHIC_STAGES (the compute shader is ignored, use ComputeShader)" << std::endl;
+            computePath = nullptr;
         }
 
-        // if vertex shader is given, compile vertex shader
-        unsigned int vertex;
-        if (vertexPath != nullptr)
+        // 1. retrieve the source code of the stages from filePath, resolving the includes
+        const char *stagePaths[4] = {vertexPath, fragmentPath, geometryPath, computePath};
+        std::string codes[4];
+        for (int i = 0; i < 4; i++)
         {
-            const char *vShaderCode = vertexCode.c_str();
-            vertex = glCreateShader(GL_VERTEX_SHADER);
-            glShaderSource(vertex, 1, &vShaderCode, NULL);
-            glCompileShader(vertex);
-            checkCompileErrors(vertex, "VERTEX");
+            paths[i] = stagePaths[i] != nullptr ? stagePaths[i] : "";
+            if (stagePaths[i] != nullptr && !ShaderPreprocessor::load(stagePaths[i], defines, codes[i]))
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
         }
-        // if fragment shader is given, compile fragment shader
-        unsigned int fragment;
-        if (fragmentPath != nullptr)
+        std::string &vertexCode = codes[0];
+        std::string &fragmentCode = codes[1];
+        std::string &geometryCode = codes[2];
+        std::string &computeCode = codes[3];
+
+        // use the program of other shader with the same sources if there is one
+        ProgramCache &cache = ProgramCache::shared();
+        std::vector<std::string> sources = {vertexCode, fragmentCode, geometryCode, computeCode};
+        uint64_t cacheKey = cache.key(sources);
+        program = ShaderRegistry::shared().find(cacheKey, sources);
+        if (program == nullptr)
         {
-            const char *fShaderCode = fragmentCode.c_str();
-            fragment = glCreateShader(GL_FRAGMENT_SHADER);
-            glShaderSource(fragment, 1, &fShaderCode, NULL);
-            glCompileShader(fragment);
-            checkCompileErrors(fragment, "FRAGMENT");
+            program = std::make_shared<ShaderProgram>();
+            program->sources = std::move(sources);
+            program->key = cacheKey;
+            ID = program->ID = glCreateProgram();
+
+            // the program is loaded from the binary cache if it was linked in a previous run
+            if (cache.load(ID, cacheKey))
+                setupProgram();
+            else
+                submit(vertexPath != nullptr ? vertexCode.c_str() : nullptr, fragmentPath != nullptr ? fragmentCode.c_str() : nullptr,
+                       geometryPath != nullptr ? geometryCode.c_str() : nullptr, computePath != nullptr ? computeCode.c_str() : nullptr);
+
+            ShaderRegistry::shared().add(cacheKey, program);
         }
-        // if geometry shader is given, compile geometry shader
-        unsigned int geometry;
-        if (geometryPath != nullptr)
+
+        ID = program->ID;
+        if (!ShaderRegistry::shared().getAsync())
+            wait();
+    }
+
+    Shader(const Shader &) = delete;
+    Shader &operator=(const Shader &) = delete;
+
+    /**
+     * @brief Destroy the Shader object
+     * 
+     * The program is deleted if no other shader uses it. It is virtual because the compute
+     * shaders (see ComputeShader) can be deleted through a pointer to Shader.
+     */
+    virtual ~Shader()
+    {
+        if (program->owner == this)
+            program->owner = nullptr;
+    }
+
+    /**
+     * @brief Get a permutation of the shader, the same files with other defines.
+     * 
+     * The permutations are created once and shared by this shader and the callers, so they
+     * can be given to the models (Model::setShader) and outlive this shader. The ones with the
+     * same code share the program (see ShaderRegistry). Use it to pick a cheaper version of a
+     * shader for a model (for example less iterations) instead of branching in the shader.
+     * 
+     * @param variantDefines Defines of the permutation, added to the ones of this shader (they replace the ones with the same name).
+     * @return std::shared_ptr<Shader> Shader of the permutation (this shader if the defines do not change and it is owned by a std::shared_ptr).
+     */
+    std::shared_ptr<Shader> getVariant(const ShaderDefines &variantDefines)
+    {
+        ShaderDefines merged = variantDefines;
+        merged.insert(defines.begin(), defines.end());
+        if (merged == defines)
         {
-            const char *gShaderCode = geometryCode.c_str();
-            geometry = glCreateShader(GL_GEOMETRY_SHADER);
-            glShaderSource(geometry, 1, &gShaderCode, NULL);
-            glCompileShader(geometry);
-            checkCompileErrors(geometry, "GEOMETRY");
+            std::shared_ptr<Shader> self = this->weak_from_this().lock();
+            if (self != nullptr)
+                return self;
         }
-        // if compute shader is given, compile compute shader
-        unsigned int compute;
-        if (computePath != nullptr)
+
+        std::shared_ptr<Shader> &variant = variants[merged];
+        if (variant == nullptr)
         {
-            const char *cShaderCode = computeCode.c_str();
-            compute = glCreateShader(GL_COMPUTE_SHADER);
-            glShaderSource(compute, 1, &cShaderCode, NULL);
-            glCompileShader(compute);
-            checkCompileErrors(compute, "COMPUTE");
+            const char *stagePaths[4];
+            for (int i = 0; i < 4; i++)
+                stagePaths[i] = paths[i].empty() ? nullptr : paths[i].c_str();
+            variant = std::make_shared<Shader>(stagePaths[0], stagePaths[1], stagePaths[2], stagePaths[3], merged);
         }
-        // shader Program
-        ID = glCreateProgram();
-        if (vertexPath != nullptr)
-            glAttachShader(ID, vertex);
-        if (fragmentPath != nullptr)
-            glAttachShader(ID, fragment);
-        if (geometryPath != nullptr)
-            glAttachShader(ID, geometry);
-        if (computePath != nullptr)
-            glAttachShader(ID, compute);
-        glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessery
-        if (vertexPath != nullptr)
-            glDeleteShader(vertex);
-        if (fragmentPath != nullptr)
-            glDeleteShader(fragment);
-        if (geometryPath != nullptr)
-            glDeleteShader(geometry);
-        if (computePath != nullptr)
-            glDeleteShader(compute);
+
+        return variant;
+    }
+
+    /**
+     * @brief Get the Defines object
+     * 
+     * @return const ShaderDefines& Defines of the permutation of the shader.
+     */
+    [[nodiscard]] const ShaderDefines &getDefines() const
+    {
+        return defines;
     }
 
     /**
@@ -216,9 +459,85 @@ public:
      */
     void use()
     {
+        if (!ready)
+            wait();
         glUseProgram(ID);
     }
 
+    /**
+     * @brief Check if the program is linked, without waiting for the driver if possible.
+     * 
+     * If the driver does not have GL_KHR_parallel_shader_compile the program is finished
+     * when this method is called (waiting for the compilation).
+     * 
+     * @return true If the shader can be used.
+     */
+    bool isReady()
+    {
+        if (ready)
+            return true;
+
+        if (!program->ready && ShaderRegistry::shared().hasParallelCompile())
+        {
+            GLint completed = 0;
+            glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &completed);
+            if (completed == 0)
+                return false;
+        }
+
+        wait();
+        return true;
+    }
+
+    /**
+     * @brief Wait until the program is linked and take its uniforms.
+     * 
+     * The values set while the program was being built are applied.
+     */
+    void wait()
+    {
+        if (ready)
+            return;
+
+        if (!program->ready)
+            finishProgram();
+
+        ready = true;
+        values = program->defaults;
+        dirty.assign(program->uniforms.size(), 0);
+        for (const auto &pending : pendingValues)
+        {
+            int handle = getUniformHandle(pendingNames[-2 - pending.first]);
+            setValue(handle, pending.second.first, pending.second.second.data(), pending.second.second.size());
+        }
+        pendingValues.clear();
+    }
+
+    /**
+     * @brief Get the handle of a uniform.
+     * 
+     * The handle does not change while the shader exists, use it to set the uniforms that
+     * are set very often without searching them by name. While the program is being built
+     * the uniforms are not known yet, the handles given meanwhile are resolved by name when
+     * they are used.
+     * 
+     * @param name Name of the uniform.
+     * @return int Handle of the uniform (-1 if the program does not have an active uniform with that name).
+     */
+    int getUniformHandle(const std::string &name) const
+    {
+        if (!ready)
+        {
+            std::vector<std::string>::const_iterator it = std::find(pendingNames.begin(), pendingNames.end(), name);
+            if (it == pendingNames.end())
+                it = pendingNames.insert(pendingNames.end(), name);
+            return -2 - (int)(it - pendingNames.begin());
+        }
+
+        std::unordered_map<std::string, int>::const_iterator it = program->handles.find(name);
+        return it != program->handles.end() ? it->second : -1;
+    }
+
     /**
      * @brief Set a Bool uniform in the shader.
      * 
@@ -227,14 +546,19 @@ public:
      */
     void setBool(const std::string &name, bool value)
     {
+        setBool(getUniformHandle(name), value);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_BOOLEAN;
-        uniform.UD_boolean = value;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a Bool uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param value Value of the uniform.
+     */
+    void setBool(int handle, bool value)
+    {
+        int data = (int)value;
+        setValue(handle, U_BOOLEAN, &data, 1);
     }
 
     /**
@@ -245,14 +569,18 @@ public:
      */
     void setInt(const std::string &name, int value)
     {
+        setInt(getUniformHandle(name), value);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_INTEGER;
-        uniform.UD_integer = value;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a Int uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param value Value of the uniform.
+     */
+    void setInt(int handle, int value)
+    {
+        setValue(handle, U_INTEGER, &value, 1);
     }
 
     /**
@@ -263,14 +591,18 @@ public:
      */
     void setFloat(const std::string &name, float value)
     {
+        setFloat(getUniformHandle(name), value);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_FLOAT;
-        uniform.UD_float = value;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a Float uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param value Value of the uniform.
+     */
+    void setFloat(int handle, float value)
+    {
+        setValue(handle, U_FLOAT, &value, 1);
     }
 
     /**
@@ -281,14 +613,18 @@ public:
      */
     void setVec2(const std::string &name, const glm::vec2 &value)
     {
+        setVec2(getUniformHandle(name), value);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_VEC2;
-        uniform.UD_vec2 = value;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a two dimensional vector uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param value Value of the uniform.
+     */
+    void setVec2(int handle, const glm::vec2 &value)
+    {
+        setValue(handle, U_VEC2, &value[0], 2);
     }
 
     /**
@@ -300,14 +636,20 @@ public:
      */
     void setVec2(const std::string &name, float x, float y)
     {
+        setVec2(getUniformHandle(name), x, y);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_VEC2;
-        uniform.UD_vec2 = glm::vec2(x, y);
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a two dimensional vector uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param x First value of the vector.
+     * @param y Second value of the vector.
+     */
+    void setVec2(int handle, float x, float y)
+    {
+        glm::vec2 value(x, y);
+        setValue(handle, U_VEC2, &value[0], 2);
     }
 
     /**
@@ -318,14 +660,18 @@ public:
      */
     void setVec3(const std::string &name, const glm::vec3 &value)
     {
+        setVec3(getUniformHandle(name), value);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_VEC3;
-        uniform.UD_vec3 = value;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a tree dimensional vector uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param value Value of the uniform.
+     */
+    void setVec3(int handle, const glm::vec3 &value)
+    {
+        setValue(handle, U_VEC3, &value[0], 3);
     }
 
     /**
@@ -338,14 +684,21 @@ public:
      */
     void setVec3(const std::string &name, float x, float y, float z)
     {
+        setVec3(getUniformHandle(name), x, y, z);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_VEC3;
-        uniform.UD_vec3 = glm::vec3(x, y, z);
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a tree dimensional vector uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param x First value of the vector.
+     * @param y Seconds value of the vector.
+     * @param z Third value of the vector.
+     */
+    void setVec3(int handle, float x, float y, float z)
+    {
+        glm::vec3 value(x, y, z);
+        setValue(handle, U_VEC3, &value[0], 3);
     }
 
     /**
@@ -356,20 +709,24 @@ public:
      */
     void setVec4(const std::string &name, const glm::vec4 &value)
     {
+        setVec4(getUniformHandle(name), value);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_VEC4;
-        uniform.UD_vec4 = value;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a four dimensional vector uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param value Value of the uniform.
+     */
+    void setVec4(int handle, const glm::vec4 &value)
+    {
+        setValue(handle, U_VEC4, &value[0], 4);
     }
 
     /**
      * @brief Set a four dimensional vector uniform in the shader.
      * 
-     * @param name Name of the uniform
+     * @param name Name of the uniform.
      * @param x First value of the vector.
      * @param y Seconds value of the vector.
      * @param z Third value of the vector.
@@ -377,14 +734,22 @@ public:
      */
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
+        setVec4(getUniformHandle(name), x, y, z, w);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_VEC4;
-        uniform.UD_vec4 = glm::vec4(x, y, z, w);
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a four dimensional vector uniform in the shader.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param x First value of the vector.
+     * @param y Seconds value of the vector.
+     * @param z Third value of the vector.
+     * @param w Fourth value of the vector.
+     */
+    void setVec4(int handle, float x, float y, float z, float w)
+    {
+        glm::vec4 value(x, y, z, w);
+        setValue(handle, U_VEC4, &value[0], 4);
     }
 
     /**
@@ -395,14 +760,18 @@ public:
      */
     void setMat2(const std::string &name, const glm::mat2 &mat)
     {
+        setMat2(getUniformHandle(name), mat);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_MAT2;
-        uniform.UD_mat2 = mat;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a 2x2 matrix as a uniform.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param mat Value of the uniform.
+     */
+    void setMat2(int handle, const glm::mat2 &mat)
+    {
+        setValue(handle, U_MAT2, &mat[0][0], 4);
     }
 
     /**
@@ -413,14 +782,18 @@ public:
      */
     void setMat3(const std::string &name, const glm::mat3 &mat)
     {
+        setMat3(getUniformHandle(name), mat);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_MAT3;
-        uniform.UD_mat3 = mat;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a 3x3 matrix as a uniform.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param mat Value of the uniform.
+     */
+    void setMat3(int handle, const glm::mat3 &mat)
+    {
+        setValue(handle, U_MAT3, &mat[0][0], 9);
     }
 
     /**
@@ -431,76 +804,344 @@ public:
      */
     void setMat4(const std::string &name, const glm::mat4 &mat)
     {
+        setMat4(getUniformHandle(name), mat);
+    }
 
-        // create uniform storing the data
-        UniformData uniform = UniformData();
-        uniform.myType = U_MAT4;
-        uniform.UD_mat4 = mat;
-
-        // overwrite information
-        myUniforms[name] = uniform;
+    /**
+     * @brief Set a 4x4 matrix as a uniform.
+     * 
+     * @param handle Handle of the uniform (see getUniformHandle).
+     * @param mat Value of the uniform.
+     */
+    void setMat4(int handle, const glm::mat4 &mat)
+    {
+        setValue(handle, U_MAT4, &mat[0][0], 16);
     }
 
     /**
      * @brief Update the values of the uniform with the actualized data of the variables.
      * 
      * This method should be called every frame, otherwise, the data of the uniforms in the shaders 
-     * is not updated in the program.
+     * is not updated in the program. Only the uniforms that changed since the last call are
+     * uploaded, the program keeps the values of the rest. If other shader that shares the
+     * program updated it meanwhile, the values that are different from its ones are uploaded.
+     * The shader must be in use.
      */
     void updateUniform()
     {
 
-        for (std::map<std::string, UniformData>::iterator it = myUniforms.begin(); it != myUniforms.end(); ++it)
+        if (program->owner != this)
         {
+            dirtyUniforms.clear();
+            for (size_t handle = 0; handle < program->uniforms.size(); handle++)
+            {
+                const ShaderUniform &uniform = program->uniforms[handle];
+                dirty[handle] = 0;
+                if (std::memcmp(&values[uniform.offset], &program->current[uniform.offset], uniform.words * sizeof(float)) != 0)
+                    dirtyUniforms.push_back((int)handle);
+            }
+            program->owner = this;
+        }
 
-            // we obtain the uniform from the hash
-            std::string name = it->first;
-            UniformData uniform = it->second;
+        for (int handle : dirtyUniforms)
+        {
+            const ShaderUniform &uniform = program->uniforms[handle];
+            const float *value = &values[uniform.offset];
+            std::memcpy(&program->current[uniform.offset], value, uniform.words * sizeof(float));
+            GLint integer;
+            std::memcpy(&integer, value, sizeof(integer));
 
             // identify and define the uniform
-            switch (uniform.myType)
+            switch (uniform.type)
             {
 
             case U_BOOLEAN:
-                glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)uniform.UD_boolean);
-                break;
-
             case U_INTEGER:
-                glUniform1i(glGetUniformLocation(ID, name.c_str()), uniform.UD_integer);
+                glUniform1i(uniform.location, integer);
                 break;
 
             case U_FLOAT:
-                glUniform1f(glGetUniformLocation(ID, name.c_str()), uniform.UD_float);
+                glUniform1f(uniform.location, value[0]);
                 break;
 
             case U_VEC2:
-                glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &uniform.UD_vec2[0]);
+                glUniform2fv(uniform.location, 1, value);
                 break;
 
             case U_VEC3:
-                glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &uniform.UD_vec3[0]);
+                glUniform3fv(uniform.location, 1, value);
                 break;
 
             case U_VEC4:
-                glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &uniform.UD_vec4[0]);
+                glUniform4fv(uniform.location, 1, value);
                 break;
 
             case U_MAT2:
-                glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &uniform.UD_mat2[0][0]);
+                glUniformMatrix2fv(uniform.location, 1, GL_FALSE, value);
                 break;
 
             case U_MAT3:
-                glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &uniform.UD_mat3[0][0]);
+                glUniformMatrix3fv(uniform.location, 1, GL_FALSE, value);
                 break;
 
             case U_MAT4:
-                glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &uniform.UD_mat4[0][0]);
+                glUniformMatrix4fv(uniform.location, 1, GL_FALSE, value);
                 break;
             }
+
+            dirty[handle] = 0;
         }
+
+        dirtyUniforms.clear();
     }
 
 private:
+    /**
+     * @brief Get the active uniforms of the program after linking it (stored in the program).
+     * 
+     * The uniforms in blocks and the ones of types that can not be set are ignored. The
+     * initial values are read from the program, so a value equal to the one the program
+     * already has is not uploaded.
+     */
+    void queryUniforms()
+    {
+        GLint count = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+
+        for (GLint i = 0; i < count; i++)
+        {
+            GLchar name[256];
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum glType = 0;
+            glGetActiveUniform(ID, (GLuint)i, sizeof(name), &length, &size, &glType, name);
+
+            ShaderUniform uniform;
+            uniform.name = std::string(name, length);
+            if (uniform.name.size() > 3 && uniform.name.compare(uniform.name.size() - 3, 3, "[0]") == 0)
+                uniform.name.resize(uniform.name.size() - 3);
+
+            uniform.location = glGetUniformLocation(ID, uniform.name.c_str());
+            if (uniform.location < 0 || !uniformType(glType, uniform.type, uniform.words))
+                continue;
+
+            std::vector<float> &defaults = program->defaults;
+            uniform.offset = defaults.size();
+            defaults.resize(defaults.size() + uniform.words);
+            if (uniform.type == U_BOOLEAN || uniform.type == U_INTEGER)
+            {
+                GLint integer = 0;
+                glGetUniformiv(ID, uniform.location, &integer);
+                std::memcpy(&defaults[uniform.offset], &integer, sizeof(integer));
+            }
+            else
+            {
+                glGetUniformfv(ID, uniform.location, &defaults[uniform.offset]);
+            }
+
+            program->handles[uniform.name] = (int)program->uniforms.size();
+            program->uniforms.push_back(uniform);
+        }
+
+        program->current = program->defaults;
+    }
+
+    /**
+     * @brief Get the type of a uniform from its OpenGL type.
+     * 
+     * @param glType OpenGL type of the uniform.
+     * @param type Type of the uniform.
+     * @param words Number of 4 bytes words of the value.
+     * @return true If the uniform can be set with the methods of the shader.
+     */
+    static bool uniformType(GLenum glType, dataType &type, size_t &words)
+    {
+        switch (glType)
+        {
+        case GL_BOOL:
+            type = U_BOOLEAN;
+            words = 1;
+            return true;
+        case GL_INT:
+        case GL_SAMPLER_1D:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_SHADOW:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_SAMPLER_BUFFER:
+        case GL_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+            type = U_INTEGER;
+            words = 1;
+            return true;
+        case GL_FLOAT:
+            type = U_FLOAT;
+            words = 1;
+            return true;
+        case GL_FLOAT_VEC2:
+            type = U_VEC2;
+            words = 2;
+            return true;
+        case GL_FLOAT_VEC3:
+            type = U_VEC3;
+            words = 3;
+            return true;
+        case GL_FLOAT_VEC4:
+            type = U_VEC4;
+            words = 4;
+            return true;
+        case GL_FLOAT_MAT2:
+            type = U_MAT2;
+            words = 4;
+            return true;
+        case GL_FLOAT_MAT3:
+            type = U_MAT3;
+            words = 9;
+            return true;
+        case GL_FLOAT_MAT4:
+            type = U_MAT4;
+            words = 16;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    /**
+     * @brief Store the value of a uniform, marking it to be uploaded if it changed.
+     * 
+     * The booleans and the integers are interchangeable (both are set with glUniform1i), the
+     * values of other types than the one of the uniform are ignored (as OpenGL does).
+     * 
+     * @param handle Handle of the uniform (ignored if it is -1).
+     * @param type Type of the value.
+     * @param data Value (floats or the bits of an integer).
+     * @param words Number of 4 bytes words of the value.
+     */
+    void setValue(int handle, dataType type, const void *data, size_t words)
+    {
+        // handle given while the program was being built
+        if (handle <= -2 && -2 - handle < (int)pendingNames.size())
+        {
+            if (!ready)
+            {
+                std::vector<float> value((const float *)data, (const float *)data + words);
+                for (auto &pending : pendingValues)
+                {
+                    if (pending.first == handle)
+                    {
+                        pending.second = {type, value};
+                        return;
+                    }
+                }
+                pendingValues.push_back({handle, {type, value}});
+                return;
+            }
+
+            handle = getUniformHandle(pendingNames[-2 - handle]);
+        }
+
+        if (handle < 0 || handle >= (int)program->uniforms.size())
+            return;
+
+        const ShaderUniform &uniform = program->uniforms[handle];
+        bool integer = type == U_BOOLEAN || type == U_INTEGER;
+        bool uniformInteger = uniform.type == U_BOOLEAN || uniform.type == U_INTEGER;
+        if ((integer ? !uniformInteger : uniform.type != type) || uniform.words != words)
+            return;
+
+        float *value = &values[uniform.offset];
+        if (std::memcmp(value, data, words * sizeof(float)) == 0)
+            return;
+
+        std::memcpy(value, data, words * sizeof(float));
+        if (!dirty[handle])
+        {
+            dirty[handle] = 1;
+            dirtyUniforms.push_back(handle);
+        }
+    }
+
+    /**
+     * @brief Submit the sources of the stages to the driver and link them in the program.
+     * 
+     * The status of the compilation is not asked here (it would wait for the driver), the
+     * stages are checked by finishProgram.
+     * 
+     * @param vShaderCode Code of the vertex shader (nullptr if the program does not have it).
+     * @param fShaderCode Code of the fragment shader (nullptr if the program does not have it).
+     * @param gShaderCode Code of the geometry shader (nullptr if the program does not have it).
+     * @param cShaderCode Code of the compute shader (nullptr if the program does not have it).
+     */
+    void submit(const char *vShaderCode, const char *fShaderCode, const char *gShaderCode, const char *cShaderCode)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        const std::pair<GLenum, const char *> stages[4] = {{GL_VERTEX_SHADER, vShaderCode}, {GL_FRAGMENT_SHADER, fShaderCode},
+                                                           {GL_GEOMETRY_SHADER, gShaderCode}, {GL_COMPUTE_SHADER, cShaderCode}};
+        const char *names[4] = {"VERTEX", "FRAGMENT", "GEOMETRY", "COMPUTE"};
+
+        // compile the stages that are given
+        for (int i = 0; i < 4; i++)
+        {
+            if (stages[i].second == nullptr)
+                continue;
+
+            unsigned int shader = glCreateShader(stages[i].first);
+            glShaderSource(shader, 1, &stages[i].second, NULL);
+            glCompileShader(shader);
+            program->pendingStages.push_back({shader, names[i]});
+        }
+
+        // shader Program (the binary is kept to store it in the cache)
+        ProgramCache::shared().prepare(ID);
+        for (const std::pair<GLuint, std::string> &stage : program->pendingStages)
+            glAttachShader(ID, stage.first);
+        glLinkProgram(ID);
+
+        program->ready = false;
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        program->submitMilliseconds = elapsed.count();
+    }
+
+    /**
+     * @brief Check the stages and the link of a program submitted, waiting for the driver.
+     * 
+     */
+    void finishProgram()
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (const std::pair<GLuint, std::string> &stage : program->pendingStages)
+            checkCompileErrors(stage.first, stage.second);
+        checkCompileErrors(ID, "PROGRAM");
+
+        // delete the shaders as they're linked into our program now and no longer necessery
+        for (const std::pair<GLuint, std::string> &stage : program->pendingStages)
+            glDeleteShader(stage.first);
+        program->pendingStages.clear();
+
+        setupProgram();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        ProgramCache::shared().countCompile(program->submitMilliseconds + elapsed.count());
+        ProgramCache::shared().store(ID, program->key);
+    }
+
+    /**
+     * @brief Get the uniforms of the program linked and bind its uniform blocks.
+     * 
+     */
+    void setupProgram()
+    {
+        queryUniforms();
+
+        // the uniforms of the frame are in the buffer bound by the scene
+        GLuint frameBlock = glGetUniformBlockIndex(ID, FRAME_BLOCK_NAME);
+        if (frameBlock != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, frameBlock, FRAME_BLOCK_BINDING);
+
+        program->ready = true;
+    }
+
     /**
      * @brief Check if there are error in the compilation of the shader.
      * 
@@ -0,0 +1,215 @@
+/**
+ * @file ShaderPreprocessor.h
+ * @brief File with the preprocessing of the GLSL files before compiling them.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * The GLSL files can include other files, the path is relative to the file that includes it:
+ *
+ *      #include "FrameBlock.glsl"
+ *
+ * Each file is included once in a stage (the following includes of the same file are ignored).
+ * The defines of the shader (see ShaderDefines) are written after the #version line, so a file
+ * can give a default value that the shader can change:
+ *
+ *      #ifndef MAXITER
+ *      #define MAXITER 128
+ *      #endif
+ *
+ * The source of each file is marked with #line directives (the source string number is the
+ * order in which the file was included, 0 for the main file), so the errors of the compiler
+ * point to the line of the original file.
+ */
+
+#ifndef RENDERENGINE_SHADERPREPROCESSOR_H
+#define RENDERENGINE_SHADERPREPROCESSOR_H
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//! Defines given to a shader (name and value), sorted by name so equal sets are equal maps
+using ShaderDefines = std::map<std::string, std::string>;
+
+/**
+ * @brief Methods to read the GLSL files resolving their includes and adding the defines.
+ *
+ */
+class ShaderPreprocessor
+{
+public:
+    //! Maximum depth of the includes (deeper includes are considered a cycle)
+    static const int MAX_INCLUDE_DEPTH = 16;
+
+    /**
+     * @brief Read a GLSL file and preprocess it.
+     *
+     * @param path Path to the file.
+     * @param defines Defines added after the #version line.
+     * @param code String where the preprocessed code is stored.
+     * @return true If the file and all its includes were read.
+     */
+    static bool load(const std::string &path, const ShaderDefines &defines, std::string &code)
+    {
+        std::string source;
+        if (!readFile(path, source))
+        {
+            error("no se pudo leer el archivo " + path);
+            return false;
+        }
+
+        return process(source, path, defines, code);
+    }
+
+    /**
+     * @brief Preprocess the source of a GLSL file.
+     *
+     * @param source Source of the file.
+     * @param path Path to the file (the includes are relative to its directory).
+     * @param defines Defines added after the #version line.
+     * @param code String where the preprocessed code is stored.
+     * @return true If all the includes were read.
+     */
+    static bool process(const std::string &source, const std::string &path, const ShaderDefines &defines, std::string &code)
+    {
+        code.clear();
+        std::vector<std::string> files = {path};
+        std::string body;
+        size_t versionEnd = 0;
+
+        // the #version must be the first directive, the defines go after it
+        size_t start = source.find_first_not_of(" \t\r\n");
+        if (start != std::string::npos && source.compare(start, 8, "#version") == 0)
+        {
+            versionEnd = source.find('\n', start);
+            versionEnd = versionEnd == std::string::npos ? source.size() : versionEnd + 1;
+            code.append(source, 0, versionEnd);
+            if (code.back() != '\n')
+                code += '\n';
+        }
+
+        for (const auto &define : defines)
+            code += "#define " + define.first + " " + define.second + "\n";
+
+        int firstLine = 1 + (int)std::count(source.begin(), source.begin() + versionEnd, '\n');
+        code += "#line " + std::to_string(firstLine) + " 0\n";
+        if (!expand(source.substr(versionEnd), path, firstLine, 0, 0, files, body))
+            return false;
+
+        code += body;
+        return true;
+    }
+
+private:
+    /**
+     * @brief Read the content of a file.
+     *
+     * @param path Path to the file.
+     * @param content String where the content is stored.
+     * @return true If the file was read.
+     */
+    static bool readFile(const std::string &path, std::string &content)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+            return false;
+
+        std::stringstream stream;
+        stream << file.rdbuf();
+        content = stream.str();
+        return true;
+    }
+
+    /**
+     * @brief Get the directory of a path, with the final separator.
+     *
+     * @param path Path to a file.
+     * @return std::string Directory of the file (empty if the path has no directory).
+     */
+    static std::string directoryOf(const std::string &path)
+    {
+        size_t separator = path.find_last_of("/\\");
+        return separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+    }
+
+    /**
+     * @brief Copy the source of a file replacing its includes by their content.
+     *
+     * @param source Source of the file.
+     * @param path Path to the file.
+     * @param firstLine Line of the file where the source starts.
+     * @param fileIndex Source string number of the file (for the #line directives).
+     * @param depth Depth of the include.
+     * @param files Files included in the stage (the position is their source string number).
+     * @param out String where the code is appended.
+     * @return true If all the includes were read.
+     */
+    static bool expand(const std::string &source, const std::string &path, int firstLine, int fileIndex, int depth,
+                       std::vector<std::string> &files, std::string &out)
+    {
+        std::istringstream stream(source);
+        std::string line;
+        int lineNumber = firstLine - 1;
+        while (std::getline(stream, line))
+        {
+            lineNumber++;
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+            {
+                out += line;
+                out += '\n';
+                continue;
+            }
+
+            size_t open = line.find('"', start + 8);
+            size_t close = open == std::string::npos ? std::string::npos : line.find('"', open + 1);
+            if (close == std::string::npos)
+            {
+                error(path + ":" + std::to_string(lineNumber) + ": #include sin nombre de archivo entre comillas");
+                return false;
+            }
+
+            std::string included = directoryOf(path) + line.substr(open + 1, close - open - 1);
+            if (std::find(files.begin(), files.end(), included) != files.end())
+            {
+                // already included, the line is kept empty so the numbers do not change
+                out += '\n';
+                continue;
+            }
+
+            std::string content;
+            if (depth + 1 >= MAX_INCLUDE_DEPTH || !readFile(included, content))
+            {
+                error(path + ":" + std::to_string(lineNumber) + ": no se pudo incluir " + included);
+                return false;
+            }
+
+            int includedIndex = (int)files.size();
+            files.push_back(included);
+            out += "#line 1 " + std::to_string(includedIndex) + "\n";
+            if (!expand(content, included, 1, includedIndex, depth + 1, files, out))
+                return false;
+            out += "#line " + std::to_string(lineNumber + 1) + " " + std::to_string(fileIndex) + "\n";
+        }
+
+        return true;
+    }
+
+    /**
+     * @brief Method to give an error message
+     *
+     * @param msg Message to show as an Error.
+     */
+    static void error(const std::string &msg)
+    {
+        std::cout << "Error: "
+                  << "SHADER PREPROCESSOR: " << msg << std::endl;
+    }
+};
+
+#endif //RENDERENGINE_SHADERPREPROCESSOR_H
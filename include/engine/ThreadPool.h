@@ -0,0 +1,217 @@
+/**
+ * @file ThreadPool.h
+ * @brief File with the pool of threads used by the engine to run work in the background.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ */
+
+#ifndef RENDERENGINE_THREADPOOL_H
+#define RENDERENGINE_THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+/**
+ * @brief Pool of worker threads that execute the tasks submitted to it.
+ *
+ * Tasks are executed in the order they are submitted. The engine uses a single pool shared
+ * by all the systems (see ThreadPool::shared()) so the number of threads does not grow with
+ * the number of loaders.
+ */
+class ThreadPool
+{
+
+private:
+    //! Threads of the pool
+    std::vector<std::thread> workers;
+
+    //! Tasks waiting to be executed
+    std::queue<std::function<void()>> tasks;
+
+    //! Mutex protecting the queue of tasks
+    std::mutex mutex;
+
+    //! Condition used to wake up the workers when there are new tasks
+    std::condition_variable condition;
+
+    //! True when the pool is being destroyed
+    bool stopping = false;
+
+    /**
+     * @brief State shared by the threads that execute a parallelFor.
+     *
+     */
+    struct ParallelForState
+    {
+        //! Next index to be processed
+        std::atomic<size_t> next{0};
+
+        //! Number of indexes already processed
+        size_t done = 0;
+
+        //! Number of indexes to process
+        size_t count = 0;
+
+        //! Function to call for each index
+        std::function<void(size_t)> function;
+
+        //! Mutex protecting done
+        std::mutex mutex;
+
+        //! Condition used to notify when all the indexes have been processed
+        std::condition_variable finished;
+    };
+
+    /**
+     * @brief Process indexes of a parallelFor until there are no more left.
+     *
+     * @param state State of the parallelFor.
+     */
+    static void runParallelFor(const std::shared_ptr<ParallelForState> &state)
+    {
+        for (size_t i = state->next++; i < state->count; i = state->next++)
+        {
+            state->function(i);
+
+            std::lock_guard<std::mutex> lock(state->mutex);
+            if (++state->done == state->count)
+                state->finished.notify_all();
+        }
+    }
+
+public:
+    /**
+     * @brief Construct a new Thread Pool object.
+     *
+     * @param threads Number of worker threads.
+     */
+    explicit ThreadPool(unsigned int threads = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        for (unsigned int i = 0; i < threads; i++)
+        {
+            workers.emplace_back([this]() {
+                while (true)
+                {
+                    std::function<void()> task;
+                    {
+                        std::unique_lock<std::mutex> lock(this->mutex);
+                        this->condition.wait(lock, [this]() { return this->stopping || !this->tasks.empty(); });
+
+                        if (this->stopping && this->tasks.empty())
+                            return;
+
+                        task = std::move(this->tasks.front());
+                        this->tasks.pop();
+                    }
+                    task();
+                }
+            });
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /**
+     * @brief Destroy the Thread Pool object.
+     *
+     * The tasks already submitted are executed before the threads finish.
+     */
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    /**
+     * @brief Submit a task to be executed by the pool.
+     *
+     * @param task Function to execute.
+     * @return std::future Future with the result of the task.
+     */
+    template <class F>
+    auto submit(F &&task) -> std::future<decltype(task())>
+    {
+        using Result = decltype(task());
+
+        std::shared_ptr<std::packaged_task<Result()>> packaged =
+            std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> future = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace([packaged]() { (*packaged)(); });
+        }
+        condition.notify_one();
+
+        return future;
+    }
+
+    /**
+     * @brief Call a function for every index in [0, count) using several threads.
+     *
+     * The calling thread also processes indexes, so the method can be used from a task of
+     * the pool without the risk of waiting for tasks that can not start.
+     *
+     * @param count Number of indexes.
+     * @param maxThreads Maximum number of threads (including the caller) used.
+     * @param function Function called with each index.
+     */
+    void parallelFor(size_t count, unsigned int maxThreads, const std::function<void(size_t)> &function)
+    {
+        if (count == 0)
+            return;
+
+        std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+        state->count = count;
+        state->function = function;
+
+        size_t helpers = std::min({(size_t)std::max(1u, maxThreads), workers.size() + 1, count}) - 1;
+        for (size_t i = 0; i < helpers; i++)
+            submit([state]() { runParallelFor(state); });
+
+        runParallelFor(state);
+
+        // wait for the indexes taken by the helpers
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->finished.wait(lock, [&state]() { return state->done == state->count; });
+    }
+
+    /**
+     * @brief Get the number of threads of the pool.
+     *
+     * @return size_t Number of worker threads.
+     */
+    [[nodiscard]] size_t size() const
+    {
+        return workers.size();
+    }
+
+    /**
+     * @brief Get the pool shared by all the engine.
+     *
+     * @return ThreadPool& Pool with one thread per hardware thread.
+     */
+    static ThreadPool &shared()
+    {
+        static ThreadPool pool;
+        return pool;
+    }
+};
+
+#endif //RENDERENGINE_THREADPOOL_H
@@ -0,0 +1,357 @@
+/**
+ * @file UniformBuffer.h
+ * @brief File with the uniform blocks declared as C++ structs.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * A struct is used as a uniform block if its members follow the std140 layout. The layout of
+ * the members is calculated at compile time with Std140Layout and checked with static_assert
+ * against the offsets of the struct, so a struct that does not match the block does not
+ * compile:
+ *
+ *      struct Material
+ *      {
+ *          glm::vec4 color;
+ *          glm::vec3 emission;
+ *          float roughness;
+ *      };
+ *      static_assert(Std140Layout<glm::vec4, glm::vec3, float>::check(sizeof(Material),
+ *                    offsetof(Material, color), offsetof(Material, emission), offsetof(Material, roughness)),
+ *                    "Material must follow the std140 layout");
+ *
+ * The values are kept in a UniformBuffer<T>, its set method only copies the member and marks
+ * its bytes as dirty, and upload sends the dirty range to the GPU.
+ */
+
+#ifndef RENDERENGINE_UNIFORMBUFFER_H
+#define RENDERENGINE_UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @brief Round a value up to a multiple of an alignment.
+ *
+ * @param value Value to round.
+ * @param alignment Alignment (power of two).
+ * @return size_t Smallest multiple of the alignment that is not less than the value.
+ */
+constexpr size_t std140RoundUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+/**
+ * @brief Alignment and size of a type in the std140 layout.
+ *
+ * Only the types whose C++ representation is the same than in std140 are defined (mat2, mat3
+ * and the arrays of scalars have padding between their elements in std140, use vec4 instead).
+ */
+template <typename T>
+struct Std140;
+
+//! float in std140
+template <>
+struct Std140<float>
+{
+    static constexpr size_t alignment = 4;
+    static constexpr size_t size = 4;
+};
+
+//! int in std140
+template <>
+struct Std140<int32_t>
+{
+    static constexpr size_t alignment = 4;
+    static constexpr size_t size = 4;
+};
+
+//! uint (and bool, stored as 4 bytes) in std140
+template <>
+struct Std140<uint32_t>
+{
+    static constexpr size_t alignment = 4;
+    static constexpr size_t size = 4;
+};
+
+//! vec2 in std140
+template <>
+struct Std140<glm::vec2>
+{
+    static constexpr size_t alignment = 8;
+    static constexpr size_t size = 8;
+};
+
+//! vec3 in std140 (a scalar can use the last 4 bytes)
+template <>
+struct Std140<glm::vec3>
+{
+    static constexpr size_t alignment = 16;
+    static constexpr size_t size = 12;
+};
+
+//! vec4 in std140
+template <>
+struct Std140<glm::vec4>
+{
+    static constexpr size_t alignment = 16;
+    static constexpr size_t size = 16;
+};
+
+//! ivec4 in std140
+template <>
+struct Std140<glm::ivec4>
+{
+    static constexpr size_t alignment = 16;
+    static constexpr size_t size = 16;
+};
+
+//! mat4 in std140 (four vec4 columns)
+template <>
+struct Std140<glm::mat4>
+{
+    static constexpr size_t alignment = 16;
+    static constexpr size_t size = 64;
+};
+
+//! Arrays in std140, each element is aligned to 16 bytes
+template <typename T, size_t N>
+struct Std140<T[N]>
+{
+    static constexpr size_t alignment = std140RoundUp(Std140<T>::alignment, 16);
+    static constexpr size_t size = N * std140RoundUp(Std140<T>::size, 16);
+};
+
+/**
+ * @brief Layout std140 of a block with the given members (in order).
+ *
+ * @tparam Members Types of the members of the block.
+ */
+template <typename... Members>
+struct Std140Layout
+{
+    //! Number of members of the block
+    static constexpr size_t count = sizeof...(Members);
+
+    /**
+     * @brief Get the offset of each member in the block.
+     *
+     * @return std::array<size_t, count> Offsets in bytes.
+     */
+    static constexpr std::array<size_t, count> offsets()
+    {
+        std::array<size_t, count> result{};
+        size_t offset = 0;
+        size_t i = 0;
+        ((offset = std140RoundUp(offset, Std140<Members>::alignment), result[i++] = offset, offset += Std140<Members>::size), ...);
+        return result;
+    }
+
+    /**
+     * @brief Get the size of the block.
+     *
+     * @return size_t Size in bytes, the end of the last member rounded up to 16 bytes.
+     */
+    static constexpr size_t size()
+    {
+        size_t offset = 0;
+        ((offset = std140RoundUp(offset, Std140<Members>::alignment) + Std140<Members>::size), ...);
+        return std140RoundUp(offset, 16);
+    }
+
+    /**
+     * @brief Check that a struct has the layout of the block (use it in a static_assert).
+     *
+     * @param structSize Size of the struct (sizeof).
+     * @param memberOffsets Offset of each member of the struct (offsetof), in the order of Members.
+     * @return true If the struct has the size and the offsets of the block and the C++ types have the std140 sizes.
+     */
+    template <typename... Offsets>
+    static constexpr bool check(size_t structSize, Offsets... memberOffsets)
+    {
+        static_assert(sizeof...(Offsets) == count, "an offset is needed for each member");
+
+        std::array<size_t, count> expected = offsets();
+        std::array<size_t, count> actual = {(size_t)memberOffsets...};
+        for (size_t i = 0; i < count; i++)
+        {
+            if (expected[i] != actual[i])
+                return false;
+        }
+
+        bool sizes = ((sizeof(Members) == Std140<Members>::size) && ...);
+        return sizes && structSize == size();
+    }
+};
+
+/**
+ * @brief Uniform buffer with the values of a uniform block.
+ *
+ * The values are kept in the CPU, the methods that change them only copy the bytes and extend
+ * the dirty range, upload sends that range to the buffer. The buffer is created in the first
+ * upload, so the object can be created before the OpenGL context.
+ *
+ * @tparam T Struct with the std140 layout of the block (checked with Std140Layout).
+ */
+template <typename T>
+class UniformBuffer
+{
+    static_assert(std::is_trivially_copyable<T>::value, "the block is copied to the GPU with memcpy");
+    static_assert(sizeof(T) % 16 == 0, "the size of a std140 block is a multiple of 16 bytes");
+
+private:
+    //! Values of the block
+    T data;
+
+    //! OpenGL buffer (0 until the first upload)
+    GLuint buffer = 0;
+
+    //! Binding point of the block
+    GLuint binding;
+
+    //! First byte that changed since the last upload
+    size_t dirtyBegin = 0;
+
+    //! Byte after the last one that changed since the last upload (0 if there are no changes)
+    size_t dirtyEnd = sizeof(T);
+
+    /**
+     * @brief Extend the dirty range.
+     *
+     * @param begin First byte that changed.
+     * @param end Byte after the last one that changed.
+     */
+    void markDirty(size_t begin, size_t end)
+    {
+        if (this->dirtyEnd == 0)
+        {
+            this->dirtyBegin = begin;
+            this->dirtyEnd = end;
+            return;
+        }
+
+        this->dirtyBegin = std::min(this->dirtyBegin, begin);
+        this->dirtyEnd = std::max(this->dirtyEnd, end);
+    }
+
+public:
+    /**
+     * @brief Construct a new Uniform Buffer object
+     *
+     * @param bindingPoint Binding point of the block (see glUniformBlockBinding).
+     * @param initial Initial values of the block.
+     */
+    explicit UniformBuffer(GLuint bindingPoint, const T &initial = T()) : data(initial), binding(bindingPoint)
+    {
+    }
+
+    UniformBuffer(const UniformBuffer &) = delete;
+    UniformBuffer &operator=(const UniformBuffer &) = delete;
+
+    /**
+     * @brief Delete the buffer of the GPU (the next upload creates it again).
+     *
+     * It is not done by the destructor because the objects usually outlive the OpenGL
+     * context, it must be called while the context exists.
+     */
+    void release()
+    {
+        if (this->buffer != 0)
+            glDeleteBuffers(1, &this->buffer);
+        this->buffer = 0;
+        this->markDirty(0, sizeof(T));
+    }
+
+    /**
+     * @brief Set a member of the block.
+     *
+     * @tparam M Type of the member.
+     * @param member Pointer to the member (for example &Material::color).
+     * @param value New value of the member.
+     */
+    template <typename M>
+    void set(M T::*member, const M &value)
+    {
+        M &target = this->data.*member;
+        if (std::memcmp(&target, &value, sizeof(M)) == 0)
+            return;
+
+        std::memcpy(&target, &value, sizeof(M));
+        size_t offset = (size_t)((const unsigned char *)&target - (const unsigned char *)&this->data);
+        this->markDirty(offset, offset + sizeof(M));
+    }
+
+    /**
+     * @brief Replace all the values of the block.
+     *
+     * @param values New values of the block.
+     */
+    void set(const T &values)
+    {
+        this->data = values;
+        this->markDirty(0, sizeof(T));
+    }
+
+    /**
+     * @brief Get the values of the block.
+     *
+     * @return const T& Values of the block.
+     */
+    [[nodiscard]] const T &get() const
+    {
+        return data;
+    }
+
+    /**
+     * @brief Send the values that changed to the GPU.
+     *
+     */
+    void upload()
+    {
+        if (this->buffer == 0)
+        {
+            glGenBuffers(1, &this->buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+            glBufferData(GL_UNIFORM_BUFFER, sizeof(T), &this->data, GL_DYNAMIC_DRAW);
+            this->dirtyEnd = 0;
+            return;
+        }
+
+        if (this->dirtyEnd == 0)
+            return;
+
+        glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, (GLintptr)this->dirtyBegin, (GLsizeiptr)(this->dirtyEnd - this->dirtyBegin),
+                        (const unsigned char *)&this->data + this->dirtyBegin);
+        this->dirtyEnd = 0;
+    }
+
+    /**
+     * @brief Bind the buffer to the binding point of the block.
+     *
+     */
+    void bind() const
+    {
+        glBindBufferBase(GL_UNIFORM_BUFFER, this->binding, this->buffer);
+    }
+
+    /**
+     * @brief Get the binding point of the block.
+     *
+     * @return GLuint Binding point.
+     */
+    [[nodiscard]] GLuint getBinding() const
+    {
+        return binding;
+    }
+};
+
+#endif //RENDERENGINE_UNIFORMBUFFER_H
@@ -0,0 +1,479 @@
+/**
+ * @file VertexLayout.h
+ * @brief File with the description of the format of the vertex of the models.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * All the attributes of a vertex are stored together (interleaved) in a single buffer, the
+ * layout says where each attribute is inside the vertex. The attributes always use the same
+ * location in the shaders, so a shader works with any model that has the attributes it reads:
+ *
+ *      layout (location = 0) in vec3 aPos;
+ *      layout (location = 1) in vec3 aColor;
+ *      layout (location = 2) in vec3 aNormal;
+ *      layout (location = 3) in vec2 aTexCoord;
+ *
+ * The model matrix of each instance is not part of the vertex, the Scene gives it in a
+ * separate buffer with one matrix per instance (see VertexLayout::applyInstances):
+ *
+ *      layout (location = 4) in mat4 aInstanceModel;
+ *
+ * The formats known at compile time are described with VertexFormatDescriptor, which calculates
+ * the offsets and the stride as constants with the same rules than VertexLayout::add:
+ *
+ *      using ColoredVertex = VertexFormatDescriptor<VertexAttrib<ATTRIBUTE_POSITION, GL_FLOAT, 3>,
+ *                                                   VertexAttrib<ATTRIBUTE_COLOR, GL_UNSIGNED_BYTE, 4, GL_TRUE>>;
+ *      static_assert(ColoredVertex::stride() == 16, "");
+ *      ColoredVertex::apply();                              // or VertexLayout::of<ColoredVertex>()
+ *
+ * The quantized formats (see VertexFormat) are read by the same declarations: the positions
+ * are normalized to [0, 1] inside the bounding box of the model (the Model gives the matrix that
+ * undoes it, see Model::getDequantizationMatrix) and the texture coordinates are half floats.
+ * The normals are octahedral encoded in 2 components, so the shaders that use them must declare
+ * them as vec2 and decode them with octahedralDecode, including Shaders/Octahedral.glsl.
+ */
+
+#ifndef RENDERENGINE_VERTEXLAYOUT_H
+#define RENDERENGINE_VERTEXLAYOUT_H
+
+#include <glad/glad.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Attributes of the vertex, the value is the location used in the shaders.
+ *
+ */
+enum VertexAttributeLocation
+{
+    ATTRIBUTE_POSITION = 0,
+    ATTRIBUTE_COLOR = 1,
+    ATTRIBUTE_NORMAL = 2,
+    ATTRIBUTE_TEXCOORD = 3,
+    ATTRIBUTE_INSTANCE_MODEL = 4
+};
+
+/**
+ * @brief Formats used to store the attributes of the vertex.
+ *
+ */
+enum VertexFormat
+{
+    //! All the attributes are 32 bits floats
+    VERTEX_FORMAT_FLOAT = 0,
+
+    //! Positions 3x16 bits normalized, normals octahedral 2x16 bits and texture coordinates 2x16 bits half floats
+    VERTEX_FORMAT_QUANTIZED_16 = 1,
+
+    //! Like VERTEX_FORMAT_QUANTIZED_16 but the normals are octahedral 2x8 bits (they use the padding of the position)
+    VERTEX_FORMAT_QUANTIZED_8 = 2
+};
+
+/**
+ * @brief Description of an attribute inside the vertex.
+ *
+ */
+struct VertexAttribute
+{
+    //! Location of the attribute in the shaders
+    GLuint location;
+
+    //! Number of components of the attribute
+    GLint size;
+
+    //! Type of each component (GL_FLOAT, ...)
+    GLenum type;
+
+    //! If the integer components are normalized to [0, 1] or [-1, 1]
+    GLboolean normalized;
+
+    //! Offset in bytes of the attribute from the beginning of the vertex
+    GLuint offset;
+
+    //! Number of instances that use each value (0 if the attribute advances once per vertex)
+    GLuint divisor = 0;
+};
+
+/**
+ * @brief Get the size of a component type.
+ *
+ * @param type Type of the component (GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, ...).
+ * @return GLuint Size in bytes.
+ */
+constexpr GLuint vertexTypeSize(GLenum type)
+{
+    switch (type)
+    {
+    case GL_BYTE:
+    case GL_UNSIGNED_BYTE:
+        return 1;
+    case GL_SHORT:
+    case GL_UNSIGNED_SHORT:
+    case GL_HALF_FLOAT:
+        return 2;
+    default:
+        return 4;
+    }
+}
+
+/**
+ * @brief Get the offset of an attribute placed after the end of the previous one.
+ *
+ * Each attribute starts at an offset multiple of the size of its components, so small
+ * attributes can fill the padding of the previous one.
+ *
+ * @param end Byte after the end of the previous attribute (0 for the first one).
+ * @param type Type of the components of the attribute.
+ * @return GLuint Offset of the attribute.
+ */
+constexpr GLuint vertexAttributeOffset(GLuint end, GLenum type)
+{
+    return (end + vertexTypeSize(type) - 1) / vertexTypeSize(type) * vertexTypeSize(type);
+}
+
+/**
+ * @brief Get the stride of a vertex (multiple of 4 bytes, the alignment that the GPUs need to
+ * read the vertex without penalty).
+ *
+ * @param end Byte after the end of the last attribute.
+ * @return GLsizei Size of the vertex in bytes.
+ */
+constexpr GLsizei vertexStride(GLuint end)
+{
+    return (GLsizei)((end + 3) & ~3u);
+}
+
+/**
+ * @brief Attribute of a format known at compile time (see VertexFormatDescriptor).
+ *
+ * @tparam Location Location of the attribute in the shaders.
+ * @tparam Type Type of each component (GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, ...).
+ * @tparam Size Number of components.
+ * @tparam Normalized If the integer components are normalized.
+ * @tparam Divisor Number of instances that use each value (0 to advance once per vertex).
+ */
+template <GLuint Location, GLenum Type, GLint Size, GLboolean Normalized = GL_FALSE, GLuint Divisor = 0>
+struct VertexAttrib
+{
+    static constexpr GLuint location = Location;
+    static constexpr GLenum type = Type;
+    static constexpr GLint size = Size;
+    static constexpr GLboolean normalized = Normalized;
+    static constexpr GLuint divisor = Divisor;
+};
+
+/**
+ * @brief Format of a vertex known at compile time.
+ *
+ * The offsets, the stride and the mask are constants, and apply configures the attributes
+ * without building a VertexLayout.
+ *
+ * @tparam Attributes Attributes of the vertex (VertexAttrib), in the order they are stored.
+ */
+template <typename... Attributes>
+struct VertexFormatDescriptor
+{
+    //! Number of attributes of the vertex
+    static constexpr size_t count = sizeof...(Attributes);
+
+    /**
+     * @brief Get the attributes with their offsets.
+     *
+     * @return std::array<VertexAttribute, count> Attributes in the order they are stored.
+     */
+    static constexpr std::array<VertexAttribute, count> attributes()
+    {
+        std::array<VertexAttribute, count> result{};
+        GLuint end = 0;
+        size_t i = 0;
+        ((result[i] = {Attributes::location, Attributes::size, Attributes::type, Attributes::normalized,
+                       vertexAttributeOffset(end, Attributes::type), Attributes::divisor},
+          end = result[i].offset + Attributes::size * vertexTypeSize(Attributes::type), i++),
+         ...);
+        return result;
+    }
+
+    /**
+     * @brief Get the offset of an attribute.
+     *
+     * @tparam Index Position of the attribute in the vertex.
+     * @return GLuint Offset in bytes from the beginning of the vertex.
+     */
+    template <size_t Index>
+    static constexpr GLuint offset()
+    {
+        static_assert(Index < count, "the vertex does not have so many attributes");
+        return attributes()[Index].offset;
+    }
+
+    /**
+     * @brief Get the size of each vertex.
+     *
+     * @return GLsizei Size in bytes.
+     */
+    static constexpr GLsizei stride()
+    {
+        GLuint end = 0;
+        ((end = vertexAttributeOffset(end, Attributes::type) + Attributes::size * vertexTypeSize(Attributes::type)), ...);
+        return vertexStride(end);
+    }
+
+    /**
+     * @brief Get a mask with a bit for the location of each attribute.
+     *
+     * @return uint32_t Mask of the attributes.
+     */
+    static constexpr uint32_t mask()
+    {
+        return (0u | ... | (1u << Attributes::location));
+    }
+
+    /**
+     * @brief Check that a struct has the layout of the vertex (use it in a static_assert).
+     *
+     * @param structSize Size of the struct (sizeof).
+     * @param memberOffsets Offset of each member of the struct (offsetof), in the order of the attributes.
+     * @return true If the struct has the stride and the offsets of the vertex.
+     */
+    template <typename... Offsets>
+    static constexpr bool check(size_t structSize, Offsets... memberOffsets)
+    {
+        static_assert(sizeof...(Offsets) == count, "an offset is needed for each attribute");
+
+        std::array<VertexAttribute, count> expected = attributes();
+        std::array<size_t, count> actual = {(size_t)memberOffsets...};
+        for (size_t i = 0; i < count; i++)
+        {
+            if (expected[i].offset != actual[i])
+                return false;
+        }
+
+        return structSize == (size_t)stride();
+    }
+
+    /**
+     * @brief Configure the attributes in the VAO currently bound.
+     *
+     * The buffer with the vertex must be bound to GL_ARRAY_BUFFER.
+     *
+     * @param baseOffset Offset in bytes of the first vertex in the buffer.
+     */
+    static void apply(size_t baseOffset = 0)
+    {
+        constexpr std::array<VertexAttribute, count> list = attributes();
+        for (const VertexAttribute &attribute : list)
+        {
+            glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, stride(),
+                                  (void *)(uintptr_t)(baseOffset + attribute.offset));
+            if (attribute.divisor != 0)
+                glVertexAttribDivisor(attribute.location, attribute.divisor);
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+};
+
+//! Model matrix of the instances (a column per location, advancing once per instance)
+using InstanceMatrixFormat = VertexFormatDescriptor<VertexAttrib<ATTRIBUTE_INSTANCE_MODEL + 0, GL_FLOAT, 4, GL_FALSE, 1>,
+                                                    VertexAttrib<ATTRIBUTE_INSTANCE_MODEL + 1, GL_FLOAT, 4, GL_FALSE, 1>,
+                                                    VertexAttrib<ATTRIBUTE_INSTANCE_MODEL + 2, GL_FLOAT, 4, GL_FALSE, 1>,
+                                                    VertexAttrib<ATTRIBUTE_INSTANCE_MODEL + 3, GL_FLOAT, 4, GL_FALSE, 1>>;
+
+static_assert(InstanceMatrixFormat::stride() == 16 * sizeof(float), "the instances are a buffer of glm::mat4");
+
+//! Vertex of VERTEX_FORMAT_QUANTIZED_8 with normal, the normal uses the padding of the position
+using Quantized8NormalFormat = VertexFormatDescriptor<VertexAttrib<ATTRIBUTE_POSITION, GL_UNSIGNED_SHORT, 3, GL_TRUE>,
+                                                      VertexAttrib<ATTRIBUTE_NORMAL, GL_BYTE, 2, GL_TRUE>>;
+
+static_assert(Quantized8NormalFormat::offset<1>() == 6 && Quantized8NormalFormat::stride() == 8,
+              "the quantized position and normal fit in 8 bytes");
+
+/**
+ * @brief Format of the vertex of a model.
+ *
+ */
+struct VertexLayout
+{
+    //! Attributes of the vertex
+    std::vector<VertexAttribute> attributes;
+
+    //! Size of each vertex in bytes
+    GLsizei stride = 0;
+
+    //! Format of the attributes
+    VertexFormat format = VERTEX_FORMAT_FLOAT;
+
+    /**
+     * @brief Create a layout where all the attributes are floats.
+     *
+     * The attributes are placed in the order position, color, normal, texture coordinate.
+     *
+     * @param color If the vertex has color (3 floats).
+     * @param normal If the vertex has normal (3 floats).
+     * @param texcoord If the vertex has texture coordinate (2 floats).
+     * @return VertexLayout Layout of the vertex.
+     */
+    static VertexLayout floats(bool color = false, bool normal = false, bool texcoord = false)
+    {
+        return create(VERTEX_FORMAT_FLOAT, color, normal, texcoord);
+    }
+
+    /**
+     * @brief Create a layout with the attributes in a format.
+     *
+     * The attributes are placed in the order position, color, normal, texture coordinate. The
+     * colors are always floats.
+     *
+     * @param format Format of the attributes.
+     * @param color If the vertex has color.
+     * @param normal If the vertex has normal.
+     * @param texcoord If the vertex has texture coordinate.
+     * @return VertexLayout Layout of the vertex.
+     */
+    static VertexLayout create(VertexFormat format, bool color = false, bool normal = false, bool texcoord = false)
+    {
+        VertexLayout layout;
+        layout.format = format;
+        bool quantized = format != VERTEX_FORMAT_FLOAT;
+
+        if (quantized)
+            layout.add(ATTRIBUTE_POSITION, 3, GL_UNSIGNED_SHORT, GL_TRUE);
+        else
+            layout.add(ATTRIBUTE_POSITION, 3, GL_FLOAT, GL_FALSE);
+
+        if (color)
+            layout.add(ATTRIBUTE_COLOR, 3, GL_FLOAT, GL_FALSE);
+
+        if (normal && format == VERTEX_FORMAT_QUANTIZED_16)
+            layout.add(ATTRIBUTE_NORMAL, 2, GL_SHORT, GL_TRUE);
+        else if (normal && format == VERTEX_FORMAT_QUANTIZED_8)
+            layout.add(ATTRIBUTE_NORMAL, 2, GL_BYTE, GL_TRUE);
+        else if (normal)
+            layout.add(ATTRIBUTE_NORMAL, 3, GL_FLOAT, GL_FALSE);
+
+        if (texcoord && quantized)
+            layout.add(ATTRIBUTE_TEXCOORD, 2, GL_HALF_FLOAT, GL_FALSE);
+        else if (texcoord)
+            layout.add(ATTRIBUTE_TEXCOORD, 2, GL_FLOAT, GL_FALSE);
+
+        return layout;
+    }
+
+    /**
+     * @brief Add an attribute at the end of the vertex.
+     *
+     * Each attribute starts at an offset multiple of the size of its components and the
+     * stride is kept multiple of 4 bytes (the alignment that the GPUs need to read the vertex
+     * without penalty), so small attributes can fill the padding of the previous one.
+     *
+     * @param location Location of the attribute in the shaders.
+     * @param size Number of components.
+     * @param type Type of the components.
+     * @param normalized If the integer components are normalized.
+     */
+    void add(GLuint location, GLint size, GLenum type, GLboolean normalized)
+    {
+        GLuint end = 0;
+        if (!attributes.empty())
+            end = attributes.back().offset + attributes.back().size * typeSize(attributes.back().type);
+        GLuint offset = vertexAttributeOffset(end, type);
+
+        attributes.push_back({location, size, type, normalized, offset});
+        stride = vertexStride(offset + size * typeSize(type));
+    }
+
+    /**
+     * @brief Create the layout of a format known at compile time.
+     *
+     * @tparam Descriptor Format of the vertex (VertexFormatDescriptor).
+     * @param format Format of the attributes (VERTEX_FORMAT_FLOAT if they are not quantized).
+     * @return VertexLayout Layout with the attributes of the descriptor.
+     */
+    template <typename Descriptor>
+    static VertexLayout of(VertexFormat format = VERTEX_FORMAT_FLOAT)
+    {
+        constexpr auto list = Descriptor::attributes();
+        VertexLayout layout;
+        layout.attributes.assign(list.begin(), list.end());
+        layout.stride = Descriptor::stride();
+        layout.format = format;
+        return layout;
+    }
+
+    /**
+     * @brief Get the size of a component type.
+     *
+     * @param type Type of the component (GL_FLOAT, GL_HALF_FLOAT, GL_SHORT, ...).
+     * @return GLuint Size in bytes.
+     */
+    static GLuint typeSize(GLenum type)
+    {
+        return vertexTypeSize(type);
+    }
+
+    /**
+     * @brief Get an attribute of the layout.
+     *
+     * @param location Location of the attribute.
+     * @return const VertexAttribute* Attribute, nullptr if the vertex does not have it.
+     */
+    [[nodiscard]] const VertexAttribute *find(GLuint location) const
+    {
+        for (const VertexAttribute &attribute : attributes)
+        {
+            if (attribute.location == location)
+                return &attribute;
+        }
+
+        return nullptr;
+    }
+
+    /**
+     * @brief Get a mask with a bit for the location of each attribute.
+     *
+     * @return uint32_t Mask of the attributes of the layout.
+     */
+    [[nodiscard]] uint32_t mask() const
+    {
+        uint32_t bits = 0;
+        for (const VertexAttribute &attribute : attributes)
+            bits |= 1u << attribute.location;
+
+        return bits;
+    }
+
+    /**
+     * @brief Configure the attributes in the VAO currently bound.
+     *
+     * The buffer with the vertex must be bound to GL_ARRAY_BUFFER.
+     */
+    void apply() const
+    {
+        for (const VertexAttribute &attribute : attributes)
+        {
+            glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized, stride,
+                                  (void *)(uintptr_t)attribute.offset);
+            if (attribute.divisor != 0)
+                glVertexAttribDivisor(attribute.location, attribute.divisor);
+            glEnableVertexAttribArray(attribute.location);
+        }
+    }
+
+    /**
+     * @brief Configure the model matrix of the instances in the VAO currently bound.
+     *
+     * The matrix uses the locations ATTRIBUTE_INSTANCE_MODEL to ATTRIBUTE_INSTANCE_MODEL + 3
+     * (one per column) and advances once per instance. The buffer with the matrices must be
+     * bound to GL_ARRAY_BUFFER.
+     *
+     * @param offset Offset in bytes of the matrix of the first instance in the buffer.
+     */
+    static void applyInstances(size_t offset)
+    {
+        InstanceMatrixFormat::apply(offset);
+    }
+};
+
+#endif //RENDERENGINE_VERTEXLAYOUT_H
@@ -0,0 +1,287 @@
+/**
+ * @file VertexQuantizer.h
+ * @brief File with the conversion of the vertex to the quantized formats.
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2020
+ *
+ * The quantized formats (see VertexFormat) use half of the memory of the floats or less, so
+ * the models use less GPU memory and the vertex fetch reads less bytes per vertex.
+ */
+
+#ifndef RENDERENGINE_VERTEXQUANTIZER_H
+#define RENDERENGINE_VERTEXQUANTIZER_H
+
+#include <VertexLayout.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/**
+ * @brief Size and precision lost when the vertex of a model are quantized.
+ *
+ */
+struct QuantizationReport
+{
+    //! Size in bytes of the vertex before the quantization
+    size_t sourceBytes = 0;
+
+    //! Size in bytes of the quantized vertex
+    size_t quantizedBytes = 0;
+
+    //! Maximum distance between a position and its quantized value (in model units)
+    float positionError = 0.0f;
+
+    //! Maximum angle between a normal and its quantized value (in degrees)
+    float normalError = 0.0f;
+
+    //! Maximum difference between a texture coordinate component and its quantized value
+    float texcoordError = 0.0f;
+};
+
+/**
+ * @brief Methods to convert float vertex to the quantized formats.
+ *
+ */
+class VertexQuantizer
+{
+public:
+    /**
+     * @brief Quantize the vertex of a model.
+     *
+     * The positions are stored normalized inside the bounding box, the shader gets them in
+     * [0, 1] and the matrix translate(boundsMin) * scale(boundsMax - boundsMin) restores them.
+     *
+     * @param vertex Vertex in float format.
+     * @param vertexCount Number of vertex.
+     * @param source Layout of the vertex (VERTEX_FORMAT_FLOAT).
+     * @param target Layout of the quantized vertex, with the same attributes than source.
+     * @param boundsMin Minimum corner of the bounding box of the positions.
+     * @param boundsMax Maximum corner of the bounding box of the positions.
+     * @param output Vector where the quantized vertex are stored.
+     * @return QuantizationReport Size and errors of the quantization.
+     */
+    static QuantizationReport quantize(const float *vertex, size_t vertexCount, const VertexLayout &source, const VertexLayout &target,
+                                       const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, std::vector<uint8_t> &output)
+    {
+        QuantizationReport report;
+        report.sourceBytes = vertexCount * source.stride;
+        report.quantizedBytes = vertexCount * target.stride;
+        output.assign(report.quantizedBytes, 0);
+
+        glm::vec3 extent = boundsMax - boundsMin;
+        size_t floats = (size_t)source.stride / sizeof(float);
+        for (size_t v = 0; v < vertexCount; v++)
+        {
+            const float *in = vertex + floats * v;
+            uint8_t *out = output.data() + (size_t)target.stride * v;
+
+            for (const VertexAttribute &attribute : target.attributes)
+            {
+                const VertexAttribute *from = source.find(attribute.location);
+                if (from == nullptr)
+                    continue;
+
+                const float *value = in + from->offset / sizeof(float);
+                uint8_t *destination = out + attribute.offset;
+
+                if (attribute.type == GL_UNSIGNED_SHORT)
+                {
+                    // position normalized inside the bounding box
+                    uint16_t q[3];
+                    float error = 0.0f;
+                    for (int i = 0; i < 3; i++)
+                    {
+                        float t = extent[i] > 0.0f ? (value[i] - boundsMin[i]) / extent[i] : 0.0f;
+                        q[i] = (uint16_t)std::lround(std::min(std::max(t, 0.0f), 1.0f) * 65535.0f);
+                        float decoded = boundsMin[i] + (float)q[i] / 65535.0f * extent[i];
+                        error += (decoded - value[i]) * (decoded - value[i]);
+                    }
+                    std::memcpy(destination, q, sizeof(q));
+                    report.positionError = std::max(report.positionError, std::sqrt(error));
+                }
+                else if (attribute.type == GL_SHORT || attribute.type == GL_BYTE)
+                {
+                    int bits = attribute.type == GL_SHORT ? 16 : 8;
+                    int16_t e[2];
+                    octahedralEncode(value, bits, e);
+                    if (bits == 16)
+                    {
+                        std::memcpy(destination, e, sizeof(e));
+                    }
+                    else
+                    {
+                        int8_t e8[2] = {(int8_t)e[0], (int8_t)e[1]};
+                        std::memcpy(destination, e8, sizeof(e8));
+                    }
+
+                    float decoded[3];
+                    octahedralDecode(e, bits, decoded);
+                    float length = std::sqrt(value[0] * value[0] + value[1] * value[1] + value[2] * value[2]);
+                    if (length > 0.0f)
+                    {
+                        float cosine = (decoded[0] * value[0] + decoded[1] * value[1] + decoded[2] * value[2]) / length;
+                        float angle = std::acos(std::min(std::max(cosine, -1.0f), 1.0f)) * 180.0f / 3.14159265f;
+                        report.normalError = std::max(report.normalError, angle);
+                    }
+                }
+                else if (attribute.type == GL_HALF_FLOAT)
+                {
+                    uint16_t h[2];
+                    for (int i = 0; i < 2; i++)
+                    {
+                        h[i] = floatToHalf(value[i]);
+                        report.texcoordError = std::max(report.texcoordError, std::fabs(halfToFloat(h[i]) - value[i]));
+                    }
+                    std::memcpy(destination, h, sizeof(h));
+                }
+                else
+                {
+                    // attributes that are not quantized (colors)
+                    std::memcpy(destination, value, (size_t)attribute.size * sizeof(float));
+                }
+            }
+        }
+
+        return report;
+    }
+
+    /**
+     * @brief Encode a normal with the octahedral mapping.
+     *
+     * Of the four nearest quantized values the one with the lowest angular error is chosen.
+     *
+     * @param normal Normal to encode (it does not need to be normalized).
+     * @param bits Bits of each component (8 or 16).
+     * @param encoded Signed normalized components of the encoding.
+     */
+    static void octahedralEncode(const float normal[3], int bits, int16_t encoded[2])
+    {
+        float length = std::fabs(normal[0]) + std::fabs(normal[1]) + std::fabs(normal[2]);
+        float u = length > 0.0f ? normal[0] / length : 0.0f;
+        float v = length > 0.0f ? normal[1] / length : 0.0f;
+        if (normal[2] < 0.0f)
+        {
+            float x = u;
+            u = (1.0f - std::fabs(v)) * (x >= 0.0f ? 1.0f : -1.0f);
+            v = (1.0f - std::fabs(x)) * (v >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        float scale = (float)((1 << (bits - 1)) - 1);
+        float bestCosine = -2.0f;
+        for (int i = 0; i < 4; i++)
+        {
+            int16_t candidate[2] = {(int16_t)((i & 1) ? std::ceil(u * scale) : std::floor(u * scale)),
+                                    (int16_t)((i & 2) ? std::ceil(v * scale) : std::floor(v * scale))};
+
+            float decoded[3];
+            octahedralDecode(candidate, bits, decoded);
+            float cosine = decoded[0] * normal[0] + decoded[1] * normal[1] + decoded[2] * normal[2];
+            if (cosine > bestCosine)
+            {
+                bestCosine = cosine;
+                encoded[0] = candidate[0];
+                encoded[1] = candidate[1];
+            }
+        }
+    }
+
+    /**
+     * @brief Decode a normal with the octahedral mapping (as octahedralDecode of Shaders/Octahedral.glsl does).
+     *
+     * @param encoded Signed normalized components of the encoding.
+     * @param bits Bits of each component (8 or 16).
+     * @param normal Normalized normal.
+     */
+    static void octahedralDecode(const int16_t encoded[2], int bits, float normal[3])
+    {
+        float scale = (float)((1 << (bits - 1)) - 1);
+        float u = std::max((float)encoded[0] / scale, -1.0f);
+        float v = std::max((float)encoded[1] / scale, -1.0f);
+
+        normal[0] = u;
+        normal[1] = v;
+        normal[2] = 1.0f - std::fabs(u) - std::fabs(v);
+        if (normal[2] < 0.0f)
+        {
+            normal[0] = (1.0f - std::fabs(v)) * (u >= 0.0f ? 1.0f : -1.0f);
+            normal[1] = (1.0f - std::fabs(u)) * (v >= 0.0f ? 1.0f : -1.0f);
+        }
+
+        float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        for (int i = 0; i < 3; i++)
+            normal[i] /= length;
+    }
+
+    /**
+     * @brief Convert a float to half float (round to nearest).
+     *
+     * @param value Float value.
+     * @return uint16_t Bits of the half float.
+     */
+    static uint16_t floatToHalf(float value)
+    {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+
+        uint16_t sign = (uint16_t)((bits >> 16) & 0x8000u);
+        uint32_t mantissa = bits & 0x7fffffu;
+        int exponent = (int)((bits >> 23) & 0xffu) - 127 + 15;
+
+        // infinite and NaN
+        if ((bits & 0x7fffffffu) >= 0x7f800000u)
+            return (uint16_t)(sign | 0x7c00u | (mantissa != 0 ? 0x200u : 0u));
+
+        // too big for a half float
+        if (exponent >= 31)
+            return (uint16_t)(sign | 0x7c00u);
+
+        // denormal or too small
+        if (exponent <= 0)
+        {
+            if (exponent < -10)
+                return sign;
+
+            mantissa |= 0x800000u;
+            int shift = 14 - exponent;
+            uint32_t half = mantissa >> shift;
+            if ((mantissa >> (shift - 1)) & 1u)
+                half++;
+            return (uint16_t)(sign | half);
+        }
+
+        // the carry of the rounding goes to the exponent, which is the correct result
+        uint32_t half = ((uint32_t)exponent << 10) | (mantissa >> 13);
+        if (mantissa & 0x1000u)
+            half++;
+        return (uint16_t)(sign | half);
+    }
+
+    /**
+     * @brief Convert a half float to float.
+     *
+     * @param half Bits of the half float.
+     * @return float Float value.
+     */
+    static float halfToFloat(uint16_t half)
+    {
+        int exponent = (half >> 10) & 0x1f;
+        int mantissa = half & 0x3ff;
+
+        float value;
+        if (exponent == 0)
+            value = std::ldexp((float)mantissa, -24);
+        else if (exponent == 31)
+            value = mantissa != 0 ? NAN : INFINITY;
+        else
+            value = std::ldexp((float)(mantissa | 0x400), exponent - 25);
+
+        return (half & 0x8000) ? -value : value;
+    }
+};
+
+#endif //RENDERENGINE_VERTEXQUANTIZER_H
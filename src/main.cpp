@@ -52,6 +52,7 @@ int main()
     render->setWindowsTitle("RenderEngine", true);
     Setup(scene, render, camera, eventHandler);
 
+    // the time spent building the shaders is printed by the scene once they are ready
     // render loop
     // -----------
     int a = 0;